@@ -14,6 +14,9 @@ public:
 
   void runAll(bool runsynctest = false);
   void performanceTest();
+  void lassoBenchmark();
+  void eraseBenchmark();
+  void pathEncodingBenchmark();
   void inputTest();
   void syncSlaveMsg(std::string msg, int level);
 
@@ -76,6 +79,12 @@ private:
   void test14();
   void test15();
   void synctest01();
+
+  bool bgSaveTest();
+  bool bgzCompatTest();
+  bool pageLoadTest();
+  bool selOrderTest();
+  bool pathHitTest();
   void synctest01slave1();
   void synctest01slave2();
 };
@@ -0,0 +1,210 @@
+#include <fstream>
+#include "docconvert.h"
+#include "ulib/painter.h"
+#include "usvg/pdfwriter.h"
+#include "scribbleconfig.h"
+
+std::mutex DocConverter::fontMutex;
+
+void DocConverter::start(const std::vector<FSPath>& files, int nthreads)
+{
+  jobs.resize(files.size());
+  for(size_t ii = 0; ii < files.size(); ++ii)
+    jobs[ii].src = files[ii];
+  // create worker pool (used by Document for page loading and compression) on main thread
+  Document::workerPool();
+  if(nthreads <= 0)
+    nthreads = std::max(1, Document::numWorkers);
+  nthreads = std::min(nthreads, std::max(1, int(jobs.size())));
+  maxInFlight = 2*nthreads;
+  for(int ii = 0; ii < nthreads; ++ii)
+    workers.emplace_back(&DocConverter::workerFn, this);
+}
+
+void DocConverter::cancel()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    cancelled = true;
+  }
+  cond.notify_all();
+  for(std::thread& t : workers)
+    t.join();
+  workers.clear();
+}
+
+// save jobs take priority over loading new documents so that memory use is bounded
+void DocConverter::workerFn()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  while(!cancelled) {
+    if(!toSave.empty()) {
+      Job* job = toSave.front();
+      toSave.pop_front();
+      lock.unlock();
+      saveJob(*job);
+      lock.lock();
+      --inFlight;
+      ++nDone;
+      cond.notify_all();
+    }
+    else if(nextLoad < jobs.size() && inFlight < maxInFlight) {
+      Job* job = &jobs[nextLoad++];
+      ++inFlight;
+      lock.unlock();
+      loadJob(*job);
+      lock.lock();
+      loaded.push_back(job);
+    }
+    else if(nextLoad >= jobs.size() && inFlight == 0)
+      break;
+    else
+      cond.wait(lock);
+  }
+}
+
+void DocConverter::loadJob(Job& job)
+{
+  FileStream* strm = new FileStream(job.src.c_str(), "rb");
+  job.doc.reset(new Document());
+  // loading all pages of a large multi-file document can take a while, so check for cancel after each page
+  auto notcancelled = [this](int, int) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return !cancelled;
+  };
+  auto res = job.doc->load(strm, false, notcancelled);
+  if(res == Document::LOAD_FATAL || (res == Document::LOAD_EMPTYDOC
+      && !containsWord("svg svgz html htm", job.src.extension().c_str()))) {
+    job.doc.reset();
+    job.status = LOAD_ERROR;
+    return;
+  }
+  // pages of .svgz documents are always delay loaded, but all pages must be loaded before update() so that
+  //  their bounds are cached on the main thread
+  if(!job.doc->ensurePagesLoaded(notcancelled) && res == Document::LOAD_OK)
+    res = Document::LOAD_NONFATAL;
+  job.loadErrors = res != Document::LOAD_OK && res != Document::LOAD_EMPTYDOC;
+}
+
+// called on main thread; returns false once all jobs are finished
+bool DocConverter::update()
+{
+  std::deque<Job*> ready;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    ready.swap(loaded);
+  }
+  for(Job* job : ready) {
+    if(job->status == PENDING) {
+      Document* doc = job->doc.get();
+      job->cfg.reset(new ScribbleConfig(globalCfg));
+      job->cfg->loadConfig(doc->getConfigNode());
+      ScribbleConfig* cfg = job->cfg.get();
+      if(doc->numPages() == 0) {
+        doc->insertPage(new Page(PageProperties(cfg->Float("pageWidth"), cfg->Float("pageHeight"),
+            cfg->Float("xRuling"), cfg->Float("yRuling"), cfg->Float("marginLeft"),
+            Color::fromRgb(cfg->Int("pageColor")), Color::fromArgb(cfg->Int("ruleColor")))), 0);
+      }
+      // cache bounds so nothing needs to be measured on worker thread (all pages were loaded by loadJob()); PDF
+      //  export may be using fonts on a worker thread
+      {
+        std::lock_guard<std::mutex> fontlock(fontMutex);
+        for(Page* page : doc->pages) {
+          if(page->loadStatus == Page::LOAD_OK)
+            page->getBBox();
+        }
+      }
+      if(getDest)
+        job->dest = getDest(*job);
+      if(job->dest.isEmpty())
+        job->status = SKIPPED;
+      cfg->set("docFormatVersion", Document::docFormatVersion);
+      cfg->saveConfig(doc->resetConfigNode());
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    if(job->status == PENDING)
+      toSave.push_back(job);
+    else {
+      job->doc.reset();
+      --inFlight;
+      ++nDone;
+    }
+  }
+  cond.notify_all();
+  std::lock_guard<std::mutex> lock(mutex);
+  return !cancelled && nDone < int(jobs.size());
+}
+
+void DocConverter::saveJob(Job& job)
+{
+  if(job.dest.extension() == "pdf") {
+    std::ofstream f(PLATFORM_STR(job.dest.c_str()), std::ios::out | std::ios::binary);
+    if(f)
+      writePDF(job.doc.get(), f);
+    job.status = f.good() ? CONVERTED : SAVE_ERROR;
+    job.doc.reset();
+    job.cfg.reset();
+    return;
+  }
+  Document::saveflags_t flags = Document::SAVE_FORCE;
+  int level = compressLevel >= 0 ? compressLevel : job.cfg->Int("compressLevel", 2);
+  flags |= level << 24;  // ignored for uncompressed formats
+  std::string thumb;
+  if(saveThumbnail) {
+    int pagenum = std::max(0, std::min(job.cfg->Int("pageNum", 0), job.doc->numPages() - 1));
+    Image thumbnail = drawThumbnail(job.doc->pages[pagenum]);
+    auto buff = base64_encode(thumbnail.encode(Image::PNG));
+    thumb = (char*)buff.data();
+  }
+  FileStream* strm = new FileStream(job.dest.c_str(), "wb+");
+  if(strm->is_open() && job.doc->save(strm, saveThumbnail ? thumb.c_str() : NULL, flags))
+    job.status = CONVERTED;
+  else {
+    job.status = SAVE_ERROR;
+    delete strm;
+  }
+  job.doc.reset();
+  job.cfg.reset();
+}
+
+// same size and scale as ScribbleArea::drawThumbnail, but at top of page; text is skipped since fonts are
+//  shared with main thread
+Image DocConverter::drawThumbnail(Page* page)
+{
+  Image thumbnail(240, 400, Image::PNG);
+  Painter painter(Painter::PAINT_SW | Painter::NO_TEXT, &thumbnail);
+  painter.beginFrame();
+  painter.setAntiAlias(true);
+  Dim scale = std::max(Dim(0.25), thumbnail.width/page->width());
+  painter.scale(scale, scale);
+  page->draw(&painter, Rect::wh(thumbnail.width/scale, thumbnail.height/scale));
+  painter.endFrame();
+  return thumbnail;
+}
+
+// pages are drawn one at a time and pages loaded only for export are unloaded again after drawing, so parsed
+//  content of at most a few pages (including those being prefetched) is in memory at once.  Output is not
+//  streamed: PdfWriter holds the compressed content of every page until pdf.write(), and export runs
+//  synchronously on the calling thread (so ScribbleApp::writePDF() blocks the GUI)
+void DocConverter::writePDF(Document* doc, std::ostream& strm)
+{
+  // text is laid out w/ shared font state when drawn, so PDF export is serialized
+  std::lock_guard<std::mutex> fontlock(fontMutex);
+  PdfWriter pdf(doc->numPages());
+  pdf.anyHref = true;  // hack to work around our hack for links
+  //pdf.compressionLevel = 0;  // for debugging
+  Dim ptsPerDim = 72.0/150;
+  pdf.resolveLink = [doc](const char* href, int* pgnum){ return doc->findNamedNode(href, pgnum); };
+  for(int ii = 0; ii < doc->numPages(); ++ii) {
+    Page* page = doc->pages[ii];
+    bool wasloaded = page->loadStatus != Page::NOT_LOADED;
+    doc->prefetchPages(ii, ii + Document::numWorkers);  // parse upcoming pages while drawing this one
+    page->ensureLoaded(false);
+    pdf.newPage(page->width(), page->height(), ptsPerDim);
+    pdf.drawNode(page->svgDoc.get());
+    // page was never loaded, so it is clean and can be reloaded from its block or file when needed
+    if(!wasloaded && page->loadStatus == Page::LOAD_OK && page->dirtyCount == 0)
+      page->unload();
+  }
+  pdf.write(strm);
+}
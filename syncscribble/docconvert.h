@@ -0,0 +1,69 @@
+#ifndef DOCCONVERT_H
+#define DOCCONVERT_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include "document.h"
+
+class ScribbleConfig;
+
+// Convert documents to another format on worker threads w/o any GUI - thumbnails are drawn with a software
+//  painter.  Bounds can only be calculated on main thread (text measurement), so loaded documents are passed
+//  back to main thread by update(), which also picks destination, before being saved on worker thread.  Documents
+//  are exported to PDF instead if destination has .pdf extension
+class DocConverter
+{
+public:
+  enum Status_t {PENDING = 0, CONVERTED, LOAD_ERROR, SAVE_ERROR, SKIPPED};
+  struct Job
+  {
+    FSPath src;
+    FSPath dest;
+    std::unique_ptr<Document> doc;
+    std::unique_ptr<ScribbleConfig> cfg;  // document config
+    Status_t status = PENDING;
+    bool loadErrors = false;  // document was loaded and saved, but may be incomplete
+  };
+
+  DocConverter(ScribbleConfig* globalcfg) : globalCfg(globalcfg) {}
+  ~DocConverter() { cancel(); }
+
+  void start(const std::vector<FSPath>& files, int nthreads = 0);
+  bool update();
+  void cancel();
+  int numDone() const { return nDone; }
+  int numJobs() const { return int(jobs.size()); }
+  const std::vector<Job>& results() const { return jobs; }
+
+  static Image drawThumbnail(Page* page);
+  static void writePDF(Document* doc, std::ostream& strm);
+  // font state used for text layout is shared by all threads, so text is only measured or drawn w/ this held
+  static std::mutex fontMutex;
+
+  // called on main thread to set destination for job; return empty path to skip
+  std::function<FSPath(const Job&)> getDest;
+  bool saveThumbnail = true;
+  int compressLevel = -1;  // if >= 0, overrides compressLevel from document config
+
+private:
+  void workerFn();
+  void loadJob(Job& job);
+  void saveJob(Job& job);
+
+  ScribbleConfig* globalCfg;
+  std::vector<Job> jobs;
+  std::vector<std::thread> workers;
+  std::mutex mutex;
+  std::condition_variable cond;
+  // all guarded by mutex
+  std::deque<Job*> loaded;
+  std::deque<Job*> toSave;
+  size_t nextLoad = 0;
+  int inFlight = 0;  // loaded but not yet saved; limited to bound memory use
+  int maxInFlight = 0;
+  bool cancelled = false;
+  std::atomic_int nDone{0};
+};
+
+#endif // DOCCONVERT_H
@@ -0,0 +1,263 @@
+#include <algorithm>
+#include <unordered_set>
+#include "docindex.h"
+#include "document.h"
+
+static const char docIndexMagic[4] = {'W', 'D', 'I', '1'};
+
+DocIndex::DocIndex(const char* root, const char* indexfile, const char* thumbcache)
+    : rootDir(root), indexFile(indexfile), thumbCacheDir(thumbcache)
+{
+  load();
+}
+
+DocIndex::~DocIndex()
+{
+  cancel = true;
+  if(crawlThread)
+    crawlThread->join();
+}
+
+// start background crawl of rootDir if one is not already running
+void DocIndex::update()
+{
+  if(updating)
+    return;
+  if(crawlThread)
+    crawlThread->join();
+  cancel = false;
+  updating = true;
+  crawlThread.reset(new std::thread(&DocIndex::crawl, this));
+}
+
+bool DocIndex::getEntry(const std::string& path, DocIndexEntry* entryout) const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = entries.find(path);
+  if(it == entries.end() || it->second.numPages <= 0)
+    return false;
+  *entryout = it->second;
+  return true;
+}
+
+// case-insensitive match of each space separated word in query against file name, title, and tags
+std::vector<std::string> DocIndex::search(const char* query) const
+{
+  std::vector<std::string> words = splitStr<std::vector>(toLower(query).c_str(), ' ', true);
+  std::vector<std::string> res;
+  std::lock_guard<std::mutex> lock(mutex);
+  for(auto& kv : entries) {
+    std::string text = toLower(FSPath(kv.first).baseName() + " " + kv.second.title + " " + kv.second.tags);
+    if(std::all_of(words.begin(), words.end(),
+        [&text](const std::string& w){ return text.find(w) != std::string::npos; }))
+      res.push_back(kv.first);
+  }
+  return res;
+}
+
+// read page count and document config from footer block; the rest of the document is never inflated
+bool DocIndex::readFooter(const char* filename, DocIndexEntry* entry)
+{
+  FileStream strm(filename, "rb");
+  if(!strm.is_open())
+    return false;
+  MemStream footerstrm;
+  minigz_io_t zistrm(strm);
+  auto blockInfo = Document::readBgzIndex(&strm);
+  if(blockInfo.empty() || !bgz_read_block(zistrm, &blockInfo.back() - 1, minigz_io_t(footerstrm)))
+    return false;
+  pugi::xml_document doc;
+  if(!doc.load_buffer_inplace(footerstrm.data(), footerstrm.size()))
+    return false;
+  pugi::xml_node defs = doc.child("defs");
+  pugi::xml_node pages = defs.find_child_by_attribute("id", "write-pages");
+  entry->numPages = std::distance(pages.children("use").begin(), pages.children("use").end());
+  pugi::xml_node cfg = defs.find_child_by_attribute("script", "type", "text/writeconfig");
+  // prefs are saved as <int>, <float>, or <string> nodes by ScribbleConfig::saveConfig()
+  for(pugi::xml_node pref : cfg.children()) {
+    const char* name = pref.attribute("name").value();
+    // allow value to be given as node contents for legacy support (as in ScribbleConfig::loadConfig)
+    const char* val = pref.attribute("value") ? pref.attribute("value").value() : pref.child_value();
+    if(strcmp(name, "docTitle") == 0)
+      entry->title = val;
+    else if(strcmp(name, "docTags") == 0)
+      entry->tags = val;
+    else if(strcmp(name, "pageNum") == 0)
+      entry->pageNum = atoi(val);
+  }
+  return entry->numPages > 0;
+}
+
+// called on crawl thread
+void DocIndex::crawl()
+{
+  std::unordered_set<std::string> seen;
+  // canonical paths of directories already crawled, so symlinks to a parent directory can't cause a loop
+  std::unordered_set<std::string> visited;
+  std::vector<FSPath> dirs = {FSPath(rootDir)};
+  bool changed = false;
+  while(!dirs.empty() && !cancel) {
+    FSPath dir = dirs.back();
+    dirs.pop_back();
+    if(!visited.insert(FSPath(canonicalPath(dir)).path).second)
+      continue;
+    for(const std::string& file : lsDirectory(dir)) {
+      if(cancel)
+        break;
+      if(file.empty() || file.front() == '.')
+        continue;
+      FSPath fileinfo = dir.child(file);
+      if(fileinfo.isDir()) {
+        dirs.push_back(fileinfo);
+        continue;
+      }
+      if(fileinfo.extension() != "svgz")
+        continue;
+      DocIndexEntry entry;
+      entry.mtime = getFileMTime(fileinfo);
+      entry.fsize = getFileSize(fileinfo);
+      seen.insert(fileinfo.path);
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = entries.find(fileinfo.path);
+        if(it != entries.end() && it->second.mtime == entry.mtime && it->second.fsize == entry.fsize)
+          continue;
+      }
+      // documents w/o a readable footer are stored with numPages = 0 so they aren't read again
+      readFooter(fileinfo.c_str(), &entry);
+      std::lock_guard<std::mutex> lock(mutex);
+      entries[fileinfo.path] = std::move(entry);
+      changed = true;
+      ++changes;
+    }
+  }
+  // only remove deleted documents if crawl was complete
+  if(!cancel) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for(auto it = entries.begin(); it != entries.end();) {
+      if(seen.count(it->first))
+        ++it;
+      else {
+        it = entries.erase(it);
+        changed = true;
+        ++changes;
+      }
+    }
+  }
+  if(changed)
+    save();
+  if(!cancel)
+    pruneThumbCache();
+  updating = false;
+}
+
+// thumbnails can be cached for documents anywhere (not just those in index), so cache files are removed only
+//  if the document path recorded in them no longer exists (or the file is not a valid cache file)
+void DocIndex::pruneThumbCache()
+{
+  if(thumbCacheDir.empty())
+    return;
+  FSPath cachedir(thumbCacheDir);
+  Timestamp now = mSecSinceEpoch()/1000;  // getFileMTime() is in seconds
+  for(const std::string& file : lsDirectory(cachedir)) {
+    if(cancel)
+      return;
+    FSPath cachefile = cachedir.child(file);
+    // leftover temp files from an interrupted write; recent ones may still be being written by document list
+    //  (getThumbnail() writes to temp file, then renames)
+    if(cachefile.extension() == "tmp") {
+      if(now - getFileMTime(cachefile) > 60*60)
+        removeFile(cachefile.path);
+      continue;
+    }
+    if(cachefile.extension() != "thumb")
+      continue;
+    ThumbCacheHeader hdr, expected;
+    std::string path;
+    {
+      FileStream strm(cachefile.c_str(), "rb");
+      if(strm.is_open() && strm.read((char*)&hdr, sizeof(hdr)) == sizeof(hdr)
+          && memcmp(hdr.magic, expected.magic, 4) == 0 && hdr.pathLen > 0 && hdr.pathLen < (1 << 16)) {
+        path.resize(hdr.pathLen);
+        if(strm.read(&path[0], hdr.pathLen) != hdr.pathLen)
+          path.clear();
+      }
+    }
+    if(path.empty() || !FSPath(path).exists())
+      removeFile(cachefile.path);
+  }
+}
+
+// index file: magic, then for each entry: path, mtime, fsize, numPages, pageNum, title, tags; strings are
+//  stored as uint32 length followed by chars
+bool DocIndex::load()
+{
+  if(indexFile.empty())
+    return false;
+  FileStream strm(indexFile.c_str(), "rb");
+  char magic[4];
+  if(!strm.is_open() || strm.read(magic, 4) != 4 || memcmp(magic, docIndexMagic, 4) != 0)
+    return false;
+  bool ok = true;
+  auto readStr = [&](std::string& s) {
+    uint32_t len = 0;
+    ok = ok && strm.read((char*)&len, sizeof(len)) == sizeof(len) && len < (1 << 16);
+    s.resize(ok ? len : 0);
+    ok = ok && (len == 0 || strm.read(&s[0], len) == len);
+  };
+  auto readVal = [&](void* dest, size_t len) { ok = ok && strm.read((char*)dest, len) == len; };
+
+  std::lock_guard<std::mutex> lock(mutex);
+  std::string path;
+  DocIndexEntry entry;
+  int32_t numpages, pagenum;
+  for(readStr(path); ok; readStr(path)) {
+    readVal(&entry.mtime, sizeof(entry.mtime));
+    readVal(&entry.fsize, sizeof(entry.fsize));
+    readVal(&numpages, sizeof(numpages));
+    readVal(&pagenum, sizeof(pagenum));
+    readStr(entry.title);
+    readStr(entry.tags);
+    if(!ok)
+      return false;  // truncated - keep what we've read
+    entry.numPages = numpages;
+    entry.pageNum = pagenum;
+    entries[path] = entry;
+  }
+  return true;
+}
+
+// called on crawl thread; written to temp file first so an interrupted save doesn't lose existing index
+bool DocIndex::save()
+{
+  if(indexFile.empty())
+    return false;
+  MemStream buff;
+  auto writeStr = [&buff](const std::string& s) {
+    uint32_t len = s.size();
+    buff.write((const char*)&len, sizeof(len));
+    buff.write(s.data(), len);
+  };
+  buff.write(docIndexMagic, 4);
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    for(auto& kv : entries) {
+      const DocIndexEntry& e = kv.second;
+      int32_t numpages = e.numPages, pagenum = e.pageNum;
+      writeStr(kv.first);
+      buff.write((const char*)&e.mtime, sizeof(e.mtime));
+      buff.write((const char*)&e.fsize, sizeof(e.fsize));
+      buff.write((const char*)&numpages, sizeof(numpages));
+      buff.write((const char*)&pagenum, sizeof(pagenum));
+      writeStr(e.title);
+      writeStr(e.tags);
+    }
+  }
+  std::string tempfile = indexFile + ".tmp";
+  {
+    FileStream strm(tempfile.c_str(), "wb");
+    if(!strm.is_open() || strm.write(buff.data(), buff.size()) != buff.size())
+      return false;
+  }
+  return moveFile(FSPath(tempfile), FSPath(indexFile));
+}
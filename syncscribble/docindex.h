@@ -0,0 +1,68 @@
+#ifndef DOCINDEX_H
+#define DOCINDEX_H
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include "basics.h"
+
+// document metadata read from bgz footer block (page list and config)
+struct DocIndexEntry
+{
+  Timestamp mtime = 0;
+  int64_t fsize = 0;
+  int numPages = 0;  // 0 if footer could not be read
+  int pageNum = 0;  // current page when document was last saved
+  std::string title;
+  std::string tags;
+};
+
+// thumbnail cache (see getThumbnail() in documentlist.cpp): one file per document holding header, document
+//  path, and icon-sized RGBA pixels, so unchanged documents never have to be inflated and have their PNG
+//  thumbnail decoded again
+struct ThumbCacheHeader
+{
+  char magic[4] = {'W', 'T', 'C', '1'};
+  int32_t width = 0, height = 0;  // 0 if document has no thumbnail
+  int32_t maxWidth = 0;  // requested width when cached
+  int64_t mtime = 0, fsize = 0;  // of document
+  uint32_t pathLen = 0;
+};
+
+// Index of metadata for all documents under docRoot, so document list can search, sort, and filter w/o opening
+//  documents.  Crawl runs on a background thread and only reads footer of documents with changed mtime or
+//  size; index is stored in a compact binary file and reloaded on startup
+class DocIndex
+{
+public:
+  DocIndex(const char* root, const char* indexfile, const char* thumbcache = "");
+  ~DocIndex();
+
+  void update();
+  bool isUpdating() const { return updating; }
+  // incremented whenever entries change, so users know when to refresh
+  int changeCount() const { return changes; }
+  bool getEntry(const std::string& path, DocIndexEntry* entryout) const;
+  std::vector<std::string> search(const char* query) const;
+
+  static bool readFooter(const char* filename, DocIndexEntry* entry);
+
+private:
+  bool load();
+  bool save();
+  void crawl();
+  void pruneThumbCache();
+
+  std::string rootDir;
+  std::string indexFile;
+  std::string thumbCacheDir;
+  mutable std::mutex mutex;
+  std::unordered_map<std::string, DocIndexEntry> entries;  // keyed by path; guarded by mutex
+  std::unique_ptr<std::thread> crawlThread;
+  std::atomic_bool cancel{false};
+  std::atomic_bool updating{false};
+  std::atomic_int changes{0};
+};
+
+#endif // DOCINDEX_H
@@ -2,16 +2,34 @@
 #include <stdio.h>
 #include <string>
 //#include <sstream>
+#include <deque>
+#include <algorithm>
+#include <unordered_set>
+#include "ulib/threadutil.h"
 #include "usvg/svgparser.h"
 #include "document.h"
 #include "basics.h"
 
+#if PLATFORM_WIN
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#elif !PLATFORM_EMSCRIPTEN
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 // Document structure and navigation:
 // document is a ordered set of pages, each of which may have different sizes, rulings, etc.
 // File formats supported:
 // - html + separate svg per page (<name>_page001.svg, etc.)
 // - single file svgz w/ full flush before each page to allow independent decompression; directory w/ page
 //  block offsets, sizes, and CRCs in gzip header extra data (see block gzip description in miniz_gzip.h)
+//  Since in-place saving was added, each page block begins with its opening <svg> tag in a deflate stored
+//  block and may end with whitespace in stored blocks (padding), so files are no longer byte-identical to those
+//  written by earlier versions, but they are still a single valid gzip stream with the same block index, so
+//  earlier versions (which inflate each block with bgz_read_block()) and plain gunzip read them unchanged
 // - single file html or svg (to support manually unzipped svgz)
 
 // Why split a document into pages instead of having a single continuous canvas?
@@ -44,7 +62,88 @@ R"(
 )";
 
 static const int SVGZ_BORDER = 10;
+static std::unique_ptr<BgzBlock> readBgzBlock(IOStream* strm, const bgz_block_info_t* info);
 size_t Document::memoryLimit = 0;
+int Document::numWorkers = 0;
+
+// shared pool for per-page work (currently serializing and compressing pages for saveBgz); returns NULL if
+//  only one core is available, in which case caller should do the work itself
+ThreadPool* Document::workerPool()
+{
+#if PLATFORM_EMSCRIPTEN
+  return NULL;
+#else
+  static std::unique_ptr<ThreadPool> pool;
+  if(!pool && numWorkers == 0) {
+    int ncores = std::thread::hardware_concurrency();
+    numWorkers = ncores > 0 ? ncores : 4;
+    if(numWorkers > 1)
+      pool.reset(new ThreadPool(numWorkers));
+  }
+  return pool.get();
+#endif
+}
+
+// read-only memory mapping of a file; data is NULL if file could not be mapped
+struct MappedFile
+{
+  const char* data = NULL;
+  size_t size = 0;
+
+  MappedFile(const char* path = NULL);
+  ~MappedFile();
+};
+
+MappedFile::MappedFile(const char* path)
+{
+  if(!path || !path[0]) return;
+#if PLATFORM_WIN
+  // file is also open for writing by blockStream
+  HANDLE hfile = CreateFileW(PLATFORM_STR(path), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+      OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if(hfile == INVALID_HANDLE_VALUE) return;
+  LARGE_INTEGER fsize;
+  if(GetFileSizeEx(hfile, &fsize) && fsize.QuadPart > 0) {
+    HANDLE hmap = CreateFileMappingW(hfile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if(hmap) {
+      data = (const char*)MapViewOfFile(hmap, FILE_MAP_READ, 0, 0, 0);
+      size = data ? size_t(fsize.QuadPart) : 0;
+      CloseHandle(hmap);  // view holds a reference to mapping
+    }
+  }
+  CloseHandle(hfile);
+#elif !PLATFORM_EMSCRIPTEN
+  int fd = open(path, O_RDONLY);
+  if(fd < 0) return;
+  struct stat st;
+  if(fstat(fd, &st) == 0 && st.st_size > 0) {
+    void* p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if(p != MAP_FAILED) {
+      data = (const char*)p;
+      size = st.st_size;
+    }
+  }
+  close(fd);  // mapping remains valid
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+  if(!data) return;
+#if PLATFORM_WIN
+  UnmapViewOfFile(data);
+#elif !PLATFORM_EMSCRIPTEN
+  munmap((void*)data, size);
+#endif
+}
+
+// reusable per-thread buffer for inflating pages; SvgParser parses in place and does not retain the buffer
+static MemStream& inflateBuffer()
+{
+  static thread_local MemStream buff(4 << 20);
+  buff.truncate(0);
+  return buff;
+}
 
 Document::Document()
 {
@@ -54,6 +153,9 @@ Document::Document()
 
 Document::~Document()
 {
+  waitForSave();
+  blockMap.reset();
+  prefetched.clear();  // worker tasks hold their own copy of page block, so no need to wait for them
   // undo item discard() accesses page->dirtyCount, so history must be deleted before pages
   // order of member destruction is well defined, so we could rely on that, but I'd rather be explicit
   delete history;
@@ -76,6 +178,10 @@ int Document::insertPage(Page* p, int where)
     pages.push_back(p);
     where = pages.size() - 1;
   }
+  updatePageNums(std::min(size_t(where), pages.size()));
+  docPages[p->svgDoc.get()] = where;
+  if(p->loadStatus == Page::LOAD_OK && !p->namedNodesIndexed)
+    indexNamedNodes(p);
   if(history->undoable())
     history->addItem(new PageAddedItem(p, where, this));
   return where;
@@ -87,48 +193,108 @@ Page* Document::deletePage(int where)  //, bool delstrokes)
   if(where < 0 || where >= (int)pages.size())
     return NULL;
   Page* page = *(pages.begin() + where);
-  // this is to handle case of replace page (delete, add new), save, then undo replacement
-  page->ensureLoaded(false);  // shouldn't be necessary
+  // this is to handle case of replace page (delete, add new), save, then undo replacement; an unloaded page
+  //  just keeps a copy of its compressed block, so it can also be moved to another document w/o loading
+  if(page->loadStatus == Page::NOT_LOADED && page->blockIdx >= 0 && !page->rawBlock && saveInProgress()
+      && !saveSafeBlock(page))
+    waitForSave();  // block not copied by saveBackground() - shouldn't happen
+  if(page->loadStatus == Page::NOT_LOADED && !page->rawBlock && page->blockIdx >= 0
+      && size_t(page->blockIdx) + 1 < blockInfo.size()) {
+    MappedFile* map = mapBlockStream();
+    ConstMemStream mapstrm(map ? map->data : "", map ? map->size : 0);
+    page->rawBlock = readBgzBlock(map ? &mapstrm : blockStream.get(), &blockInfo[page->blockIdx]);
+    if(page->rawBlock && size_t(page->blockIdx) < blockState.size())
+      page->rawBlock->padding = blockState[page->blockIdx].padding;
+  }
+  if(!page->rawBlock)
+    page->ensureLoaded(false);  // shouldn't be necessary
   page->fileName.clear();
   page->blockIdx = -1;
+  prefetched.erase(page);  // page may be discarded by undo history
+  for(auto it = namedNodes.begin(); it != namedNodes.end();)
+    it = it->second == page ? namedNodes.erase(it) : std::next(it);
+  page->namedNodesIndexed = false;
 
   //if(delstrokes)
   //  page->removeAll();
   if(history->undoable())
     history->addItem(new PageDeletedItem(page, where, this));
   pages.erase(pages.begin() + where);
+  docPages.erase(page->svgDoc.get());
+  page->pageNum = -1;
+  updatePageNums(where);
   return page;
 }
 
+// set Page.pageNum for pages[first:]; called whenever pages are inserted or removed
+void Document::updatePageNums(size_t first)
+{
+  for(size_t ii = first; ii < pages.size(); ++ii)
+    pages[ii]->pageNum = ii;
+}
+
 int Document::pageNumForElement(const Element* s) const
 {
-  SvgDocument* doc = s->node->rootDocument();
-  if(doc) {
-    for(size_t ii = 0; ii < pages.size(); ++ii) {
-      if(pages[ii]->svgDoc.get() == doc)
-        return ii;
-    }
-  }
-  return -1;
+  Page* page = pageForElement(s);
+  return page ? page->getPageNum() : -1;
 }
 
 Page* Document::pageForElement(const Element* s) const
 {
-  int n = pageNumForElement(s);
-  return n >= 0 ? pages[n] : NULL;
+  SvgDocument* doc = s->node->rootDocument();
+  if(!doc)
+    return NULL;
+  auto it = docPages.find(doc);
+  if(it != docPages.end() && it->second < pages.size() && pages[it->second]->svgDoc.get() == doc)
+    return pages[it->second];
+  // not found or stale entry - docPages is rebuilt if stale entries have accumulated
+  if(docPages.size() > 2*pages.size() + 16)
+    docPages.clear();
+  for(size_t ii = 0; ii < pages.size(); ++ii) {
+    docPages[pages[ii]->svgDoc.get()] = ii;
+    if(pages[ii]->svgDoc.get() == doc)
+      return pages[ii];
+  }
+  return NULL;
 }
 
-bool Document::ensurePagesLoaded()
+// pages are parsed on worker threads and attached here in order; progress(nloaded, total), if given, is
+//  called after each page is attached and loading stops (returning false) if it returns false
+bool Document::ensurePagesLoaded(const std::function<bool(int, int)>& progress)
 {
   bool ok = true;
-  for(Page* page : pages)
-    ok = page->ensureLoaded(false) && ok;
+  std::vector<Page*> toload;
+  for(Page* page : pages) {
+    if(page->loadStatus == Page::NOT_LOADED)
+      toload.push_back(page);
+    else
+      ok = page->loadStatus == Page::LOAD_OK && ok;
+  }
+  ThreadPool* pool = toload.size() > 1 ? workerPool() : NULL;
+  MappedFile* map = pool ? mapBlockStream() : NULL;
+  ConstMemStream mapstrm(map ? map->data : "", map ? map->size : 0);
+  IOStream* srcstrm = map ? &mapstrm : blockStream.get();
+  // limit number of parsed pages waiting to be attached
+  size_t maxahead = pool ? 2*numWorkers : 0;
+  size_t next = 0;
+  for(size_t ii = 0; ii < toload.size(); ++ii) {
+    for(next = std::max(next, ii); next < toload.size() && next < ii + maxahead; ++next)
+      startPageLoad(toload[next], srcstrm);
+    ok = toload[ii]->ensureLoaded(false) && ok;
+    if(progress && !progress(int(ii + 1), int(toload.size()))) {
+      while(++ii < next)
+        prefetched.erase(toload[ii]);
+      return false;
+    }
+  }
   return ok;
 }
 
 // save() takes ownership of outstrm iff it returns true
 bool Document::save(IOStream* outstrm, const char* thumb, saveflags_t flags)
 {
+  waitForSave();
+  blockMap.reset();  // file may be truncated or replaced
   outstrm = outstrm ? outstrm : blockStream.get();
   FSPath fileinfo(outstrm->name()[0] ? outstrm->name() : "untitled.svgz");
   if(fileinfo.extension() == "svgz")
@@ -243,11 +409,239 @@ bool Document::save(IOStream* outstrm, const char* thumb, saveflags_t flags)
   return ok;
 }
 
+// crc32_combine() from zlib - combine CRC of block with running CRC of preceding data w/o access to the data
+static uint32_t gf2_matrix_times(const uint32_t* mat, uint32_t vec)
+{
+  uint32_t sum = 0;
+  for(; vec; vec >>= 1, ++mat) {
+    if(vec & 1)
+      sum ^= *mat;
+  }
+  return sum;
+}
+
+static void gf2_matrix_square(uint32_t* square, const uint32_t* mat)
+{
+  for(int n = 0; n < 32; ++n)
+    square[n] = gf2_matrix_times(mat, mat[n]);
+}
+
+static uint32_t bgz_crc32_combine(uint32_t crc1, uint32_t crc2, size_t len2)
+{
+  uint32_t even[32];  // even-power-of-two zeros operator
+  uint32_t odd[32];  // odd-power-of-two zeros operator
+  if(len2 == 0)
+    return crc1;
+  // put operator for one zero bit in odd
+  odd[0] = 0xEDB88320UL;  // CRC-32 polynomial
+  uint32_t row = 1;
+  for(int n = 1; n < 32; ++n) {
+    odd[n] = row;
+    row <<= 1;
+  }
+  gf2_matrix_square(even, odd);  // put operator for two zero bits in even
+  gf2_matrix_square(odd, even);  // put operator for four zero bits in odd
+  // apply len2 zeros to crc1 (first square will put the operator for one zero byte, eight zero bits, in even)
+  do {
+    gf2_matrix_square(even, odd);
+    if(len2 & 1)
+      crc1 = gf2_matrix_times(even, crc1);
+    len2 >>= 1;
+    if(!len2) break;
+    gf2_matrix_square(odd, even);
+    if(len2 & 1)
+      crc1 = gf2_matrix_times(odd, crc1);
+    len2 >>= 1;
+  } while(len2);
+  return crc1 ^ crc2;
+}
+
+// append a byte aligned deflate stored block (BFINAL = 0, BTYPE = 00, then LEN, NLEN little endian)
+static void bgzStored(BgzBlock* block, const void* data, uint16_t n)
+{
+  uint8_t hdr[5] = {0x00, uint8_t(n & 0xFF), uint8_t(n >> 8), uint8_t(~n & 0xFF), uint8_t((~n >> 8) & 0xFF)};
+  block->strm.write(hdr, 5);
+  block->strm.write(data, n);
+  block->crc_32 = uint32_t(mz_crc32(block->crc_32, (const unsigned char*)data, n));
+  block->len += n;
+}
+
+// append gap bytes of stored blocks containing whitespace to block; gap must be 0 or >= 5 (size of stored
+//  block header) - this is used to fill unused space so block can be rewritten in place later
+static void bgzPad(BgzBlock* block, uint32_t gap)
+{
+  char spaces[1024];
+  memset(spaces, ' ', sizeof(spaces));
+  block->padding += gap;
+  while(gap > 0) {
+    uint32_t n = std::min(gap - 5, uint32_t(sizeof(spaces)));
+    // don't leave a remainder too small for another stored block
+    if(gap - 5 - n > 0 && gap - 5 - n < 5)
+      n -= 5;
+    bgzStored(block, spaces, n);
+    gap -= n + 5;
+  }
+}
+
+// serialize and compress a single page as an independent block; called from worker threads
+static std::unique_ptr<BgzBlock> deflatePage(Page* p, Dim y, int level, bool binpaths)
+{
+  std::unique_ptr<BgzBlock> block(new BgzBlock);
+  MemStream svgstrm(1 << 20);
+  block->ok = p->saveSVG(svgstrm, SVGZ_BORDER, y, binpaths);
+  // opening <svg> tag is written uncompressed so block can be moved w/o recompressing (relocateBgzBlock())
+  const char* svg = (const char*)svgstrm.data();
+  const char* end = svg + svgstrm.size();
+  const char* headend = std::find(std::search(svg, end, "<svg", "<svg" + 4), end, '>');
+  size_t headlen = headend < end && headend - svg < 0xFFFF ? headend - svg + 1 : 0;
+  if(headlen > 0)
+    bgzStored(block.get(), svg, uint16_t(headlen));
+  svgstrm.seek(headlen);
+  minigz_io_t zsvgstrm(svgstrm);
+  minigz_io_t zblockstrm(block->strm);
+  int nout = miniz_go(level | MINIZ_GZ_NO_FINISH, zsvgstrm, zblockstrm, &block->crc_32);
+  block->len = nout < 0 ? nout : block->len + nout;
+  return block;
+}
+
+// read compressed block from bgz file w/o inflating
+static std::unique_ptr<BgzBlock> readBgzBlock(IOStream* strm, const bgz_block_info_t* info)
+{
+  std::unique_ptr<BgzBlock> block(new BgzBlock);
+  size_t size = info[1].offset - info[0].offset;
+  block->len = info[1].len_cum - info[0].len_cum;
+  // CRC of this block only - cumulative CRC of preceding data propagates through block as if it were all zeros
+  block->crc_32 = info[1].crc32_cum ^ bgz_crc32_combine(info[0].crc32_cum, 0, block->len);
+  std::vector<char> buff(size);
+  strm->seek(info[0].offset);
+  if(size == 0 || strm->read(buff.data(), size) != size)
+    return NULL;
+  block->strm.write(buff.data(), size);
+  return block;
+}
+
+// return copy of compressed page block with SVG position changed to y; blocks written by deflatePage() begin
+//  with opening <svg> tag in a stored block for this purpose - returns NULL for blocks from older versions
+static std::unique_ptr<BgzBlock> relocateBgzBlock(const BgzBlock& src, Dim y)
+{
+  const uint8_t* data = (const uint8_t*)src.strm.data();
+  size_t size = src.strm.size();
+  if(size < 5 || (data[0] & 0x07) != 0)
+    return NULL;
+  size_t headlen = data[1] | (data[2] << 8);
+  if((headlen ^ 0xFFFF) != size_t(data[3] | (data[4] << 8)) || headlen + 5 > size || int(headlen) > src.len)
+    return NULL;
+  std::string head((const char*)data + 5, headlen);
+  size_t ypos = head.find("<svg");
+  ypos = ypos != std::string::npos ? head.find(" y=\"", ypos) : ypos;
+  size_t yend = ypos != std::string::npos ? head.find('"', ypos + 4) : ypos;
+  if(yend == std::string::npos)
+    return NULL;
+  head.replace(ypos + 4, yend - ypos - 4, fstring("%.12g", y));
+  // CRC of remainder of block
+  uint32_t restlen = src.len - headlen;
+  uint32_t restcrc = src.crc_32 ^ bgz_crc32_combine(uint32_t(mz_crc32(MINIZ_GZ_CRC32_INIT, data + 5, headlen)), 0, restlen);
+
+  std::unique_ptr<BgzBlock> block(new BgzBlock);
+  bgzStored(block.get(), head.data(), uint16_t(head.size()));
+  block->strm.write(data + 5 + headlen, size - 5 - headlen);
+  block->crc_32 = bgz_crc32_combine(block->crc_32, restcrc, restlen);
+  block->len += restlen;
+  block->padding = src.padding;
+  return block;
+}
+
+static void putLE32(uint8_t* p, uint32_t x)
+{
+  p[0] = x & 0xFF;  p[1] = (x >> 8) & 0xFF;  p[2] = (x >> 16) & 0xFF;  p[3] = (x >> 24) & 0xFF;
+}
+
+static uint32_t getLE32(const uint8_t* p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | (uint32_t(p[3]) << 24);
+}
+
+// Documents with more blocks than fit in the index in the gzip header extra field get an extended index
+//  appended as empty gzip members, which decompress to nothing, so file remains valid gzip and older versions
+//  just see an empty index.  Each member has up to BGZ_EXT_INDEX_COUNT entries in extra subfield "WI", and
+//  file ends with a fixed size member with subfield "WL" giving offset of first index member and entry count
+static const size_t BGZ_EXT_INDEX_COUNT = 4096;  // 12 bytes per entry, so < 64KB
+static const size_t BGZ_EXT_LOCATOR_SIZE = 16 + 8 + 10;
+
+// write gzip member with empty content and extra subfield id containing data
+static void bgzWriteEmptyMember(IOStream* strm, const char* id, const uint8_t* data, uint16_t n)
+{
+  uint16_t xlen = n + 4;
+  uint8_t hdr[16] = {0x1F, 0x8B, 8, 0x04 /*FEXTRA*/, 0, 0, 0, 0, 0, 0xFF, uint8_t(xlen & 0xFF), uint8_t(xlen >> 8),
+      uint8_t(id[0]), uint8_t(id[1]), uint8_t(n & 0xFF), uint8_t(n >> 8)};
+  // empty final fixed Huffman block, then CRC32 and ISIZE (both 0)
+  uint8_t tail[10] = {0x03, 0x00, 0, 0, 0, 0, 0, 0, 0, 0};
+  strm->write(hdr, 16);
+  strm->write(data, n);
+  strm->write(tail, 10);
+}
+
+static bool bgzCheckEmptyMember(const uint8_t* hdr, const char* id, uint16_t n)
+{
+  uint16_t xlen = n + 4;
+  return hdr[0] == 0x1F && hdr[1] == 0x8B && hdr[3] == 0x04 && hdr[10] == (xlen & 0xFF) && hdr[11] == (xlen >> 8)
+      && hdr[12] == id[0] && hdr[13] == id[1] && hdr[14] == (n & 0xFF) && hdr[15] == (n >> 8);
+}
+
+static void bgzWriteExtIndex(IOStream* strm, const std::vector<bgz_block_info_t>& info)
+{
+  uint32_t start = strm->tell();
+  std::vector<uint8_t> buff;
+  for(size_t ii = 0; ii < info.size(); ii += BGZ_EXT_INDEX_COUNT) {
+    size_t n = std::min(BGZ_EXT_INDEX_COUNT, info.size() - ii);
+    buff.resize(12*n);
+    for(size_t jj = 0; jj < n; ++jj) {
+      putLE32(&buff[12*jj], info[ii+jj].offset);
+      putLE32(&buff[12*jj + 4], info[ii+jj].crc32_cum);
+      putLE32(&buff[12*jj + 8], info[ii+jj].len_cum);
+    }
+    bgzWriteEmptyMember(strm, "WI", buff.data(), uint16_t(buff.size()));
+  }
+  uint8_t loc[8];
+  putLE32(loc, start);
+  putLE32(loc + 4, uint32_t(info.size()));
+  bgzWriteEmptyMember(strm, "WL", loc, 8);
+}
+
+// read index from gzip header, or extended index if present
+std::vector<bgz_block_info_t> Document::readBgzIndex(IOStream* strm)
+{
+  minigz_io_t zstrm(*strm);
+  std::vector<bgz_block_info_t> info = bgz_get_index(zstrm);
+  size_t fsize = strm->size();
+  if(!info.empty() || fsize < BGZ_EXT_LOCATOR_SIZE || fsize == SIZE_MAX)
+    return info;
+  uint8_t loc[24];
+  strm->seek(fsize - BGZ_EXT_LOCATOR_SIZE);
+  if(strm->read(loc, 24) != 24 || !bgzCheckEmptyMember(loc, "WL", 8))
+    return info;
+  uint32_t count = getLE32(loc + 20);
+  strm->seek(getLE32(loc + 16));
+  std::vector<uint8_t> buff;
+  while(info.size() < count) {
+    size_t n = std::min(BGZ_EXT_INDEX_COUNT, count - info.size());
+    buff.resize(16 + 12*n + 10);
+    if(strm->read(buff.data(), buff.size()) != buff.size() || !bgzCheckEmptyMember(buff.data(), "WI", 12*n))
+      return std::vector<bgz_block_info_t>();
+    for(size_t jj = 0; jj < n; ++jj) {
+      const uint8_t* p = &buff[16 + 12*jj];
+      info.push_back({getLE32(p), getLE32(p + 4), getLE32(p + 8), 0});
+    }
+  }
+  return info;
+}
+
 bool Document::saveBgz(IOStream* outstrm, const char* thumb, saveflags_t flags)
 {
   static size_t MAX_BLOCK_INFO_COUNT = 1024;  // MAX_BLOCK_INFO_COUNT*sizeof(bgz_block_info_t) must be < 64KB
 
   int level = (flags >> 24) & 0x0F;
+  bool binpaths = flags & SAVE_BINARY_PATHS;
   Dim totalheight = 0, maxwidth = 0;
   uint32_t crc_32 = MINIZ_GZ_CRC32_INIT;
   uint32_t len = 0;
@@ -259,10 +653,77 @@ bool Document::saveBgz(IOStream* outstrm, const char* thumb, saveflags_t flags)
     while(pagenum < pages.size() && pages[pagenum]->dirtyCount == 0 && pages[pagenum]->blockIdx == int(pagenum+1))
       ++pagenum;
   }
-  // make sure all pages beyond first dirty page are loaded
+
+  // When saving in place, dirty pages are rewritten in their existing blocks if the new block fits, with the
+  //  rest of the block filled by whitespace in deflate stored blocks, so the file remains a valid gzip stream
+  //  with pages in order; blocks written when saving in place include some slack for this.  This requires
+  //  that block and page positions are unchanged, so pages from the first inserted, deleted, resized, or
+  //  non-fitting page onward are rewritten sequentially.  If too much of the file is padding, all pages are
+  //  rewritten w/o slack
+  bool slack = (flags & SAVE_BGZ_PARTIAL) && outstrm == blockStream.get() && !blockInfo.empty();
+  bool compact = slack && bgzCompactionDue();
+  if(compact) {
+    slack = false;
+    pagenum = 0;
+  }
+  bool inplace = slack && blockInfo.size() == pages.size() + 3 && blockState.size() == blockInfo.size();
+  size_t seqpage = pagenum;  // first page to be written sequentially
+  for(size_t ii = 0; ii < pagenum; ++ii) {
+    totalheight += pages[ii]->props.height + 2*SVGZ_BORDER;
+    maxwidth = std::max(maxwidth, pages[ii]->props.width);
+  }
+  std::vector<size_t> dirtypages;
+  std::vector<Dim> dirtyys;
+  if(inplace) {
+    Dim y = totalheight;
+    for(; seqpage < pages.size(); ++seqpage) {
+      Page* p = pages[seqpage];
+      if(p->blockIdx != int(seqpage+1) || blockState[seqpage+1].y != y)
+        break;
+      if(p->dirtyCount != 0) {
+        dirtypages.push_back(seqpage);
+        dirtyys.push_back(y);
+      }
+      y += p->props.height + 2*SVGZ_BORDER;
+    }
+  }
+
+  // Unmodified pages to be written sequentially are copied from their existing compressed block (adjusting
+  //  SVG position if necessary) instead of being loaded and recompressed (except when compacting).  Blocks are
+  //  read before anything is written since we may be overwriting the file they are in
+  IOStream* srcstrm = blockStream.get();
+  std::vector<bgz_block_info_t> srcinfo(blockInfo);
+  std::vector<BgzBlockState> srcstate(blockState);
+  std::vector< std::unique_ptr<BgzBlock> > copied(pages.size());
+  auto copyBlock = [&](size_t ii, Dim y) {
+    Page* p = pages[ii];
+    if(compact || p->dirtyCount != 0)
+      return;
+    if(p->blockIdx >= 0 && size_t(p->blockIdx) + 1 < srcinfo.size()) {
+      copied[ii] = readBgzBlock(srcstrm, &srcinfo[p->blockIdx]);
+      if(!copied[ii] || size_t(p->blockIdx) >= srcstate.size())
+        return;
+      copied[ii]->padding = srcstate[p->blockIdx].padding;
+      if(srcstate[p->blockIdx].y == y)
+        return;  // position unchanged
+      copied[ii] = relocateBgzBlock(*copied[ii], y);
+    }
+    else if(p->rawBlock)
+      copied[ii] = relocateBgzBlock(*p->rawBlock, y);
+  };
+  Dim pagey = totalheight;
+  for(size_t ii = pagenum; ii < pages.size(); ++ii) {
+    if(ii >= seqpage)
+      copyBlock(ii, pagey);
+    pagey += pages[ii]->props.height + 2*SVGZ_BORDER;
+  }
+
+  // make sure all other pages to be written are loaded
   bool loadok = true;
-  for(size_t ii = pagenum; ii < pages.size(); ++ii)
-    loadok = pages[ii]->ensureLoaded(false) && loadok;
+  for(size_t ii = pagenum; ii < pages.size(); ++ii) {
+    if((ii >= seqpage && !copied[ii]) || pages[ii]->dirtyCount != 0)
+      loadok = pages[ii]->ensureLoaded(false) && loadok;
+  }
   if(!loadok && !(flags & SAVE_FORCE))
     return false;
 
@@ -270,16 +731,123 @@ bool Document::saveBgz(IOStream* outstrm, const char* thumb, saveflags_t flags)
   if(!(flags & SAVE_BGZ_PARTIAL) || outstrm != blockStream.get())
     blockInfo.clear();
 
+  // each page is an independent deflate block (full flush, fresh compressor), so pages are serialized and
+  //  compressed on the worker pool and passed to consume() in order; no more pages are submitted once
+  //  consume() returns false
+  ThreadPool* pool = workerPool();
+  auto deflatePages = [&](const std::vector<size_t>& pagenums, const std::vector<Dim>& ys,
+      const std::function<bool(size_t, std::unique_ptr<BgzBlock>)>& consume) {
+    std::deque< std::future< std::unique_ptr<BgzBlock> > > pending;
+    size_t nextout = 0;
+    bool cont = true;
+    for(size_t ii = 0; cont && ii < pagenums.size(); ++ii) {
+      Page* p = pages[pagenums[ii]];
+      std::unique_ptr<BgzBlock>& copy = copied[pagenums[ii]];
+      if(!pool) {
+        cont = consume(pagenums[nextout++], copy ? std::move(copy) : deflatePage(p, ys[ii], level, binpaths));
+        continue;
+      }
+      if(copy) {
+        std::promise< std::unique_ptr<BgzBlock> > ready;
+        ready.set_value(std::move(copy));
+        pending.push_back(ready.get_future());
+      }
+      else {
+        // bounds can only be calculated on main thread (text needs nanovg), so make sure they are cached
+        //  before serializing on worker (hyperrefs write their bbox)
+        p->getBBox();
+        Dim y = ys[ii];
+        pending.push_back(pool->enqueue([p, y, level, binpaths](){ return deflatePage(p, y, level, binpaths); }));
+      }
+      // limit number of serialized pages held in memory
+      if(int(pending.size()) >= 2*numWorkers) {
+        cont = consume(pagenums[nextout++], pending.front().get());
+        pending.pop_front();
+      }
+    }
+    // we must wait for all workers regardless of errors since they reference our pages
+    for(; !pending.empty(); pending.pop_front()) {
+      std::unique_ptr<BgzBlock> block = pending.front().get();
+      if(cont)
+        cont = consume(pagenums[nextout++], std::move(block));
+    }
+  };
+
+  bool ok = true, zok = true;
+  struct RewrittenBlock { size_t idx; uint32_t crc_32; uint32_t len; };
+  std::vector<RewrittenBlock> rewritten;
+  if(!dirtypages.empty()) {
+    size_t endpage = seqpage;
+    deflatePages(dirtypages, dirtyys, [&](size_t ii, std::unique_ptr<BgzBlock> block){
+      size_t idx = ii+1;
+      uint32_t slot = blockInfo[idx+1].offset - blockInfo[idx].offset;
+      uint32_t size = block->strm.size();
+      if(!block->ok || block->len < 0 || size > slot || (slot > size && slot - size < 5)) {
+        seqpage = ii;
+        return false;
+      }
+      bgzPad(block.get(), slot - size);
+      outstrm->seek(blockInfo[idx].offset);
+      outstrm->write(block->strm.data(), block->strm.size());
+      rewritten.push_back({idx, block->crc_32, uint32_t(block->len)});
+      blockState[idx].padding = slot - size;
+      pages[ii]->dirtyCount = 0;
+      return true;
+    });
+    // pages after one that didn't fit must now be copied (position is unchanged) or loaded too; if this
+    //  fails, leave page that didn't fit dirty (its old block is intact) and only write pages that had to be
+    //  written sequentially anyway
+    loadok = true;
+    for(size_t ii = seqpage; ii < endpage; ++ii) {
+      copyBlock(ii, srcstate[ii+1].y);
+      if(!copied[ii])
+        loadok = pages[ii]->ensureLoaded(false) && loadok;
+    }
+    if(!loadok && !(flags & SAVE_FORCE)) {
+      seqpage = endpage;
+      ok = false;
+    }
+    // update cumulative CRC and length of blocks after rewritten blocks; since CRC is linear, change in
+    //  cumulative CRC propagates through an unchanged block as if it were a block of zeros
+    if(!rewritten.empty()) {
+      auto rw = rewritten.begin();
+      uint32_t oldcrc = blockInfo[rw->idx].crc32_cum;
+      uint32_t oldlen = blockInfo[rw->idx].len_cum;
+      for(size_t idx = rw->idx; idx <= seqpage; ++idx) {
+        bgz_block_info_t& curr = blockInfo[idx];
+        bgz_block_info_t& next = blockInfo[idx+1];
+        uint32_t nextcrc = next.crc32_cum, nextlen = next.len_cum;
+        if(rw != rewritten.end() && rw->idx == idx) {
+          next.crc32_cum = bgz_crc32_combine(curr.crc32_cum, rw->crc_32, rw->len);
+          next.len_cum = curr.len_cum + rw->len;
+          ++rw;
+        }
+        else {
+          if(curr.crc32_cum != oldcrc)
+            next.crc32_cum ^= bgz_crc32_combine(curr.crc32_cum ^ oldcrc, 0, nextlen - oldlen);
+          next.len_cum += curr.len_cum - oldlen;
+        }
+        oldcrc = nextcrc;
+        oldlen = nextlen;
+      }
+    }
+  }
+  for(; pagenum < seqpage; ++pagenum) {
+    totalheight += pages[pagenum]->props.height + 2*SVGZ_BORDER;
+    maxwidth = std::max(maxwidth, pages[pagenum]->props.width);
+  }
+
   MemStream tempstrm(4 << 20);  // 4 MB
   minigz_io_t ztempstrm(tempstrm);
   minigz_io_t zoutstrm(*outstrm);
 
-  uint32_t fileSize = blockInfo.empty() ? 0 : blockInfo.back().offset;  // excluding 8 byte gzip footer
+  size_t fileSize = blockInfo.empty() ? 0 : outstrm->size();
   if(blockInfo.empty()) {  // || pagenum+1 >= blockInfo.size()  -- should never happen
     // writing entire file
     outstrm->truncate(0);
     if(!outstrm->is_open())
       return false;
+    blockState.clear();
     bgz_header(zoutstrm, MAX_BLOCK_INFO_COUNT*sizeof(bgz_block_info_t));
     blockInfo.push_back({uint32_t(outstrm->tell()), crc_32, len, 0});
     tempstrm << SVGZ_HEADER;
@@ -288,6 +856,7 @@ bool Document::saveBgz(IOStream* outstrm, const char* thumb, saveflags_t flags)
     if(nout < 0) return false;
     len += (uint32_t)nout;
     blockInfo.push_back({uint32_t(outstrm->tell()), crc_32, len, 0});
+    blockState.resize(blockInfo.size());
   }
   else {
     // writing partial file starting at pagenum
@@ -296,32 +865,40 @@ bool Document::saveBgz(IOStream* outstrm, const char* thumb, saveflags_t flags)
     crc_32 = blockInfo[blockidx].crc32_cum;
     len = blockInfo[blockidx].len_cum;
     blockInfo.resize(blockidx+1);
-    // get SVG position for pages[pagenum]
-    for(size_t ii = 0; ii < pagenum; ++ii) {
-      totalheight += pages[ii]->props.height + 2*SVGZ_BORDER;
-      maxwidth = std::max(maxwidth, pages[ii]->props.width);
-    }
+    blockState.resize(blockidx+1);
   }
 
-  bool ok = true;
+  std::vector<size_t> seqpages;
+  std::vector<Dim> seqys;
   for(; pagenum < pages.size(); ++pagenum) {
-    Page* p = pages[pagenum];
-    tempstrm.truncate(0);  //MemStream tempstrm;
-    ok = p->saveSVG(tempstrm, SVGZ_BORDER, totalheight) && ok;
-    tempstrm.seek(0);
-    nout = miniz_go(level | MINIZ_GZ_NO_FINISH, ztempstrm, zoutstrm, &crc_32);
-    if(nout < 0) return false;
-    len += (uint32_t)nout;
+    seqpages.push_back(pagenum);
+    seqys.push_back(totalheight);
+    totalheight += pages[pagenum]->props.height + 2*SVGZ_BORDER;
+    maxwidth = std::max(maxwidth, pages[pagenum]->props.width);
+  }
+  deflatePages(seqpages, seqys, [&](size_t ii, std::unique_ptr<BgzBlock> block){
+    Page* p = pages[ii];
+    ok = block->ok && ok;
+    zok = block->len >= 0 && zok;
+    if(!zok) return false;
+    // copied blocks retain their padding
+    if(slack && block->padding == 0)
+      bgzPad(block.get(), std::max(uint32_t(block->strm.size()/8), uint32_t(64)));
+    outstrm->write(block->strm.data(), block->strm.size());
+    crc_32 = bgz_crc32_combine(crc_32, block->crc_32, block->len);
+    len += (uint32_t)block->len;
     blockInfo.push_back({uint32_t(outstrm->tell()), crc_32, len, 0});
-
+    blockState.back() = {seqys[ii - seqpages.front()], block->padding};
+    blockState.push_back(BgzBlockState());
     if(ok) {
       p->blockIdx = blockInfo.size() - 2;  // needed to handle page deletions properly
+      p->rawBlock.reset();
       p->dirtyCount = 0;
       //p->autoSavedDirtyCount = Page::NOT_AUTO_SAVED;
     }
-    totalheight += p->props.height + 2*SVGZ_BORDER;
-    maxwidth = std::max(maxwidth, p->props.width);
-  }
+    return true;
+  });
+  if(!zok) return false;
 
   // final block is thumbnail, config, and CSS for browser
   //MemStream tempstrm;
@@ -332,9 +909,22 @@ bool Document::saveBgz(IOStream* outstrm, const char* thumb, saveflags_t flags)
 
   // page sizes
   tempstrm << "<g id=\"write-pages\">\n";
+  // named node ids are saved w/ each page (unless an id contains chars we'd have to escape)
+  std::unordered_map<Page*, std::string> pageids;
+  std::unordered_set<Page*> badids;
+  for(auto& kv : namedNodes) {
+    std::string& ids = pageids[kv.second];
+    ids.append(ids.empty() ? "" : " ").append(kv.first);
+    if(kv.first.find_first_of(" \"&<>") != std::string::npos)
+      badids.insert(kv.second);
+  }
   for(pagenum = 0; pagenum < pages.size(); ++pagenum) {
-    tempstrm << fstring("  <use href=\"#page_%03d\" width=\"%.0f\" height=\"%.0f\"/>\n",
-        pagenum+1, pages[pagenum]->width(), pages[pagenum]->height());
+    Page* p = pages[pagenum];
+    std::string ids;
+    if(p->namedNodesIndexed && !badids.count(p))
+      ids = " data-ids=\"" + pageids[p] + "\"";
+    tempstrm << fstring("  <use href=\"#page_%03d\" width=\"%.0f\" height=\"%.0f\"%s/>\n",
+        pagenum+1, p->width(), p->height(), ids.c_str());
   }
   tempstrm << "</g>\n\n";
 
@@ -349,14 +939,20 @@ bool Document::saveBgz(IOStream* outstrm, const char* thumb, saveflags_t flags)
   if(nout < 0) return false;
   len += (uint32_t)nout;
   blockInfo.push_back({uint32_t(outstrm->tell()), crc_32, len, 0});
+  blockState.push_back(BgzBlockState());
 
   gzip_footer(zoutstrm, len, crc_32);
-  // seek back to extra header region and write index (unless too long)
-  bgz_write_index(zoutstrm, blockInfo.data(), blockInfo.size() > MAX_BLOCK_INFO_COUNT ? 0 : blockInfo.size());
+  // if index is too long for header, write extended index after gzip footer
+  bool extindex = blockInfo.size() > MAX_BLOCK_INFO_COUNT;
+  if(extindex)
+    bgzWriteExtIndex(outstrm, blockInfo);
+  size_t fileEnd = outstrm->tell();
+  // seek back to extra header region and write index (empty if extended index is used)
+  bgz_write_index(zoutstrm, blockInfo.data(), extindex ? 0 : blockInfo.size());
 
   outstrm->flush();
-  if(blockInfo.back().offset < fileSize)
-    ok = outstrm->truncate(blockInfo.back().offset + 8) && ok;
+  if(fileEnd < fileSize)
+    ok = outstrm->truncate(fileEnd) && ok;
   if(ok)
     dirtyCount = 0;
   if(ok && outstrm != blockStream.get())
@@ -364,34 +960,331 @@ bool Document::saveBgz(IOStream* outstrm, const char* thumb, saveflags_t flags)
   return ok;
 }
 
-bool Document::loadBgzPage(Page* page)
+// saveBgz() rewrites all pages w/o slack (and w/o copying compressed blocks) if too much of file is padding
+bool Document::bgzCompactionDue() const
+{
+  if(blockInfo.empty())
+    return false;
+  size_t padding = 0;
+  for(const BgzBlockState& st : blockState)
+    padding += st.padding;
+  return padding > blockInfo.back().offset/4;
+}
+
+// Background save: pages that saveBgz() will rewrite are cloned on the main thread and the snapshot is
+//  written on a separate thread while editing continues.  The snapshot shares our blockStream, so pages are
+//  not read through it during the save: blocks before the first page the save might write are read from the
+//  mapping created here, and blocks of other unloaded pages are copied to Page.rawBlock (see loadBgzPage()).
+//  waitForSave() must be called on the main thread to reconcile dirtyCounts and blockInfo - dirtyCount is
+//  reduced by its value at snapshot time, so edits made during the save (and undo past the save point) leave
+//  the page dirty, as for a synchronous save
+bool Document::saveBackground(const char* thumb, saveflags_t flags, std::function<void()> onDone)
+{
+  waitForSave();
+  if(!blockStream || !blockStream->is_open() || FSPath(blockStream->name()).extension() != "svgz")
+    return false;
+  // unmodified pages with an existing compressed block are just copied by saveBgz() (or not written at all
+  //  for partial save), so these are neither cloned nor loaded; compaction rewrites every page from its SVG
+  bool compact = (flags & SAVE_BGZ_PARTIAL) && bgzCompactionDue();
+  std::vector<bool> placeholder(pages.size(), false);
+  bool loadok = true;
+  for(size_t ii = 0; ii < pages.size(); ++ii) {
+    Page* p = pages[ii];
+    placeholder[ii] = !compact && p->dirtyCount == 0
+        && ((p->blockIdx >= 0 && size_t(p->blockIdx) + 1 < blockInfo.size()) || p->rawBlock);
+    if(!placeholder[ii])
+      loadok = p->ensureLoaded(false) && loadok;
+  }
+  if(!loadok && !(flags & SAVE_FORCE))
+    return false;
+
+  // blocks before first dirty page are not written by partial save (same test as in saveBgz)
+  size_t firstdirty = 0;
+  if((flags & SAVE_BGZ_PARTIAL) && !compact) {
+    while(firstdirty < pages.size() && pages[firstdirty]->dirtyCount == 0
+        && pages[firstdirty]->blockIdx == int(firstdirty+1))
+      ++firstdirty;
+  }
+  MappedFile* map = mapBlockStream();
+  ConstMemStream mapstrm(map ? map->data : "", map ? map->size : 0);
+  saveSafeEnd = map && firstdirty + 1 < blockInfo.size() ? blockInfo[firstdirty+1].offset : 0;
+  for(Page* p : pages) {
+    if(p->loadStatus == Page::NOT_LOADED && !p->rawBlock && p->blockIdx >= 0
+        && size_t(p->blockIdx) + 1 < blockInfo.size() && !saveSafeBlock(p)) {
+      p->rawBlock = readBgzBlock(map ? &mapstrm : blockStream.get(), &blockInfo[p->blockIdx]);
+      if(p->rawBlock && size_t(p->blockIdx) < blockState.size())
+        p->rawBlock->padding = blockState[p->blockIdx].padding;
+    }
+  }
+
+  Document* snap = new Document;
+  snap->blockStream.reset(blockStream.get());  // borrowed - released in waitForSave()
+  snap->blockInfo = blockInfo;
+  snap->blockState = blockState;
+  snap->resetConfigNode(getConfigNode());
+  savePages = pages;
+  saveDirtyCounts.clear();
+  for(size_t ii = 0; ii < pages.size(); ++ii) {
+    Page* p = pages[ii];
+    Page* q = NULL;
+    if(placeholder[ii])
+      q = new Page(p->props.width, p->props.height, p->blockIdx);  // never loaded
+    else {
+      q = new Page;
+      q->blockIdx = p->blockIdx;
+      // saveBgz() uses dirtyCount to decide which pages to write and clears it for pages written
+      q->dirtyCount = p->dirtyCount;
+    }
+    q->rawBlock = p->rawBlock;
+    q->document = snap;  // needed by loadSVG() (e.g., for bookmarks)
+    if(!placeholder[ii]) {
+      if(p->loadStatus == Page::LOAD_OK) {
+        q->loadSVG(p->svgDoc->clone());
+        // bounds can only be calculated on main thread, so ensure they are cached (hyperrefs write bbox)
+        q->getBBox();
+      }
+      else
+        q->loadStatus = Page::LOAD_SVG_ERROR;  // saveSVG() will fail, as it would for original page
+    }
+    q->namedNodesIndexed = p->namedNodesIndexed;
+    snap->pages.push_back(q);
+    saveDirtyCounts.push_back(p->dirtyCount);
+  }
+  // index for footer - entries of original pages mapped to snapshot pages
+  std::unordered_map<Page*, Page*> snappages;
+  for(size_t ii = 0; ii < pages.size(); ++ii)
+    snappages[pages[ii]] = snap->pages[ii];
+  for(auto& kv : namedNodes)
+    snap->namedNodes.emplace(kv.first, snappages[kv.second]);
+  snap->updatePageNums();
+  saveDocDirtyCount = dirtyCount;
+  saveSnapshot.reset(snap);
+  saveFinished = false;
+
+  bool hasthumb = thumb != NULL;
+  std::string thumbstr(hasthumb ? thumb : "");
+  saveThread.reset(new std::thread([this, snap, hasthumb, thumbstr, flags, onDone](){
+    saveResult = snap->saveBgz(snap->blockStream.get(), hasthumb ? thumbstr.c_str() : NULL, flags);
+    saveFinished = true;
+    if(onDone)
+      onDone();
+  }));
+  return true;
+}
+
+// returns result of most recent background save
+bool Document::waitForSave()
+{
+  if(!saveThread)
+    return saveResult;
+  saveThread->join();
+  saveThread.reset();
+  blockMap.reset();  // file may have been truncated
+  saveSafeEnd = 0;
+  Document* snap = saveSnapshot.get();
+  snap->blockStream.release();
+  if(saveResult) {
+    blockInfo.swap(snap->blockInfo);
+    blockState.swap(snap->blockState);
+    for(size_t ii = 0; ii < savePages.size(); ++ii) {
+      Page* p = savePages[ii];
+      // page may have been deleted (and possibly discarded by undo history) during save
+      if((ii >= pages.size() || pages[ii] != p) && std::find(pages.begin(), pages.end(), p) == pages.end())
+        continue;
+      if(snap->pages[ii]->dirtyCount == 0) {
+        p->dirtyCount -= saveDirtyCounts[ii];
+        p->blockIdx = snap->pages[ii]->blockIdx;
+        p->rawBlock.reset();
+      }
+    }
+    dirtyCount -= saveDocDirtyCount;
+  }
+  else {
+    blockInfo.clear();  // file is in an unknown state - force complete rewrite on next save
+    // pages whose blocks were copied can still be loaded
+    for(Page* p : pages) {
+      if(p->rawBlock)
+        p->blockIdx = -1;
+    }
+  }
+  saveSnapshot.reset();
+  savePages.clear();
+  saveDirtyCounts.clear();
+  return saveResult;
+}
+
+// map document file for reading pages to avoid a seek and read through blockStream for every page; returns
+//  NULL if file cannot be mapped (e.g. blockStream is not a regular file), in which case caller should use
+//  blockStream.  Mapping is dropped when file is written and recreated on next use; during background save,
+//  mapping created before the save started (if any) is returned and only blocks passing saveSafeBlock() may be
+//  read from it
+MappedFile* Document::mapBlockStream()
+{
+  if(!blockStream || blockInfo.empty())
+    return NULL;
+  if(saveInProgress())
+    return blockMap && blockMap->data ? blockMap.get() : NULL;
+  if(!blockMap) {
+    blockMap.reset(new MappedFile(blockStream->name()));
+    // name might not refer to the file we have open
+    if(blockMap->data && (blockMap->size != blockStream->size() || blockMap->size < blockInfo.back().offset))
+      blockMap.reset(new MappedFile());
+  }
+  return blockMap->data ? blockMap.get() : NULL;
+}
+
+// true if page's block lies before any block written by background save in progress
+bool Document::saveSafeBlock(const Page* p) const
+{
+  return p->blockIdx >= 0 && size_t(p->blockIdx) + 1 < blockInfo.size()
+      && blockInfo[p->blockIdx+1].offset <= saveSafeEnd;
+}
+
+// inflate standalone compressed block; returns false if block is corrupt
+static bool inflateRawBlock(BgzBlock* raw, MemStream& inf_block)
 {
-  MemStream inf_block(4 << 20);
-  bool ok = bgz_read_block(minigz_io_t(*blockStream.get()), &blockInfo[page->blockIdx], minigz_io_t(inf_block));
+  bgz_block_info_t info[2] = {{0, MINIZ_GZ_CRC32_INIT, 0, 0},
+      {uint32_t(raw->strm.size()), raw->crc_32, uint32_t(raw->len), 0}};
+  return bgz_read_block(minigz_io_t(raw->strm), info, minigz_io_t(inf_block));
+}
+
+// inflate and parse page from standalone compressed block; *okout set false if block is corrupt
+static SvgDocument* inflateBgzBlock(BgzBlock* raw, bool* okout)
+{
+  MemStream& inf_block = inflateBuffer();
+  *okout = inflateRawBlock(raw, inf_block);
+  return SvgParser().parseString(
+      inf_block.data(), inf_block.size(), XmlStreamReader::BufferInPlace | XmlStreamReader::ParseDefault);
+}
+
+// attach page parsed on worker thread, if any; returns false if page must be loaded normally
+bool Document::loadPrefetched(Page* page)
+{
+  auto it = prefetched.find(page);
+  if(it == prefetched.end())
+    return false;
+  std::unique_ptr<SvgDocument> doc = it->second.get();  // blocks if still in progress
+  prefetched.erase(it);
+  // on failure, page is loaded normally so error is reported the usual way
+  return doc && page->loadSVG(doc.release());
+}
 
+bool Document::loadBgzPage(Page* page)
+{
+  // blockStream is in use by background save - page is loaded from rawBlock or mapping (see saveBackground())
+  bool fromfile = page->blockIdx >= 0 && !(saveInProgress() && page->rawBlock);
+  if(fromfile && saveInProgress() && !saveSafeBlock(page)) {
+    waitForSave();  // copying block failed
+    fromfile = page->blockIdx >= 0;
+  }
+  bool ok = false;
+  MemStream& inf_block = inflateBuffer();
+  if(fromfile) {
+    MappedFile* map = mapBlockStream();
+    ConstMemStream mapstrm(map ? map->data : "", map ? map->size : 0);
+    minigz_io_t zinstrm(map ? static_cast<IOStream&>(mapstrm) : *blockStream.get());
+    ok = bgz_read_block(zinstrm, &blockInfo[page->blockIdx], minigz_io_t(inf_block));
+  }
+  else
+    ok = inflateRawBlock(page->rawBlock.get(), inf_block);  // page moved from another document
+  // pages written by Write are loaded directly; full parser handles everything else
+  if(ok && page->loadWritePage(inf_block.data(), inf_block.size()))
+    return true;
   SvgDocument* doc = SvgParser().parseString(
       inf_block.data(), inf_block.size(), XmlStreamReader::BufferInPlace | XmlStreamReader::ParseDefault);
   return doc && page->loadSVG(doc) && ok;
 }
 
+// start inflating (or reading) and parsing unloaded page on worker pool; compressed blocks are read here from
+//  blocksrc (blockStream or its mapping) since blockStream is not thread safe; result is attached by
+//  Page::ensureLoaded()
+bool Document::startPageLoad(Page* p, IOStream* blocksrc)
+{
+  ThreadPool* pool = workerPool();
+  if(!pool || p->loadStatus != Page::NOT_LOADED || prefetched.count(p))
+    return false;
+  if(p->blockIdx < 0 && !p->rawBlock) {
+    if(p->fileName.empty())
+      return false;
+    std::string filename = p->fileName;  // page from multi-file document
+    prefetched[p] = pool->enqueue([filename](){
+      return std::unique_ptr<SvgDocument>(SvgParser().parseFile(filename.c_str()));
+    });
+    return true;
+  }
+  std::shared_ptr<BgzBlock> raw = p->rawBlock;
+  if(p->blockIdx >= 0 && p->blockIdx + 1 < int(blockInfo.size()) && !(saveInProgress() && raw)) {
+    if(saveInProgress() && !saveSafeBlock(p))
+      return false;  // blockStream is in use by background save
+    raw = readBgzBlock(blocksrc, &blockInfo[p->blockIdx]);
+  }
+  if(!raw)
+    return false;
+  prefetched[p] = pool->enqueue([raw](){
+    bool ok = false;
+    std::unique_ptr<SvgDocument> doc(inflateBgzBlock(raw.get(), &ok));
+    if(!ok)
+      doc.reset();
+    return doc;
+  });
+  return true;
+}
+
+// start loading unloaded pages in [first, last] on worker threads so scrolling doesn't stall in
+//  Page::ensureLoaded()
+void Document::prefetchPages(int first, int last)
+{
+  first = std::max(0, std::min(first, numPages()));
+  last = std::max(first - 1, std::min(last, numPages() - 1));
+  // discard results for pages no longer near view - they will be loaded normally if needed
+  auto pgbegin = pages.begin() + first, pgend = pages.begin() + last + 1;
+  for(auto it = prefetched.begin(); it != prefetched.end();) {
+    if(std::find(pgbegin, pgend, it->first) == pgend)
+      it = prefetched.erase(it);
+    else
+      ++it;
+  }
+  if(!workerPool())
+    return;
+  MappedFile* map = mapBlockStream();
+  ConstMemStream mapstrm(map ? map->data : "", map ? map->size : 0);
+  IOStream* srcstrm = map ? &mapstrm : blockStream.get();
+  for(int ii = first; ii <= last; ++ii)
+    startPageLoad(pages[ii], srcstrm);
+}
+
 Document::loadresult_t Document::loadBgzDoc(IOStream* instrm)
 {
   if(!instrm->is_open())
     return LOAD_FATAL;
+  MemStream footerstrm;  // must outlive doc
   pugi::xml_document doc;
   minigz_io_t zinstrm(*instrm);
-  blockInfo = bgz_get_index(zinstrm);
+  blockInfo = readBgzIndex(instrm);
   if(!blockInfo.empty()) {
-    std::stringstream footerstrm;
-    if(bgz_read_block(zinstrm, &blockInfo.back() - 1, footerstrm)) {
-      doc.load(footerstrm);
+    if(bgz_read_block(zinstrm, &blockInfo.back() - 1, minigz_io_t(footerstrm))) {
+      doc.load_buffer_inplace(footerstrm.data(), footerstrm.size());
       // load page sizes
       pugi::xml_node pg = doc.child("defs").find_child_by_attribute("id", "write-pages").first_child();
       if(pg) {
         // we need to store block index in Page since page number could change due to page insert or delete
         int blockidx = 1;
-        for(; pg; pg = pg.next_sibling())
-          insertPage(new Page(pg.attribute("width").as_float(0), pg.attribute("height").as_float(0), blockidx++));
+        Dim y = 0;
+        blockState.assign(blockInfo.size(), BgzBlockState());
+        for(; pg; pg = pg.next_sibling()) {
+          Page* p = new Page(pg.attribute("width").as_float(0), pg.attribute("height").as_float(0), blockidx);
+          if(blockidx < int(blockState.size()))
+            blockState[blockidx].y = y;
+          y += p->props.height + 2*SVGZ_BORDER;
+          insertPage(p);
+          pugi::xml_attribute ids = pg.attribute("data-ids");
+          if(ids) {
+            for(const std::string& id : splitStr<std::vector>(ids.value(), ' ', true))
+              namedNodes.emplace(id, p);
+            p->namedNodesIndexed = true;
+          }
+          ++blockidx;
+        }
         resetConfigNode(doc.child("defs").find_child_by_attribute("script", "type", "text/writeconfig"));
         return LOAD_OK;
       }
@@ -413,9 +1306,10 @@ Document::loadresult_t Document::loadBgzDoc(IOStream* instrm)
   return LOAD_EMPTYDOC;
 }
 
-Document::loadresult_t Document::load(IOStream* instrm, bool delayload)  //const char* filename
+Document::loadresult_t Document::load(IOStream* instrm, bool delayload, const std::function<bool(int, int)>& progress)
 {
   // we take ownership of passed IOStream regardless of errors
+  blockMap.reset();
   blockStream.reset(instrm);
   // decompose filename
   FSPath fileinfo(instrm->name());
@@ -458,7 +1352,7 @@ Document::loadresult_t Document::load(IOStream* instrm, bool delayload)  //const
   if(!doc.first_child())
     return inlen == 0 && instrm->is_open() ? LOAD_EMPTYDOC : LOAD_FATAL;
 
-  return load(doc, fileinfo.parentPath().c_str(), delayload, ok);
+  return load(doc, fileinfo.parentPath().c_str(), delayload, ok, progress);
 }
 
 pugi::xml_node Document::resetConfigNode(pugi::xml_node newcfg)
@@ -484,7 +1378,8 @@ pugi::xml_node Document::getConfigNode()
 // For HTML documents, we remove <svg> or <object> elements from the pugixml document as they are processed,
 //  then retain a copy of the pugixml document, which is written back out when the document is saved
 
-Document::loadresult_t Document::load(const pugi::xml_document& doc, const char* path, bool delayload, bool ok)
+Document::loadresult_t Document::load(const pugi::xml_document& doc, const char* path, bool delayload, bool ok,
+    const std::function<bool(int, int)>& progress)
 {
   pugi::xml_node body = doc.child("html").child("body");
   // allow pages to be contained in <div>s under a top level <div id="pages"> (for layout purposes)
@@ -521,9 +1416,12 @@ Document::loadresult_t Document::load(const pugi::xml_document& doc, const char*
       else
         svgfile.insert(0, path);
       insertPage(p);
-      ok = p->loadSVGFile(svgfile.c_str(), delayload) && ok;
+      // pages are parsed in parallel below if not delay loading
+      ok = p->loadSVGFile(svgfile.c_str(), true) && ok;
     }
     while(body.remove_child("object")) {}
+    if(!delayload)
+      ok = ensurePagesLoaded(progress) && ok;
   }
   // for html, we preserve the doc contents; for svg, we just copy the config
   if(body) {
@@ -581,6 +1479,7 @@ bool Document::isEmptyFile() const
 //  call this function, then close it; mainly needed for android
  bool Document::deleteFiles()  //const char* filename
 {
+  waitForSave();
   if(!blockStream) return false;
   bool ok = true;
   for(const Page* page : pages) {
@@ -588,19 +1487,34 @@ bool Document::isEmptyFile() const
       ok = removeFile(page->fileName) && ok;
   }
   std::string filename = blockStream->name();
+  blockMap.reset();
   blockStream.reset();  // close file
   // now delete the html file
   return removeFile(filename) && ok;
 }
 
 // initial page number (e.g. page on which the id was referenced) can be passed in pagenumout - we search
-//  backwards from initial page, wrapping around as needed
+//  backwards from initial page, wrapping around as needed.  Only pages known to contain the id and pages not yet
+//  indexed are loaded
 SvgNode* Document::findNamedNode(const char* idstr, int* pagenumout) const
 {
   int n = pages.size();
   int p0 = pagenumout ? *pagenumout : n - 1;
+  std::vector<int> order;
+  auto range = namedNodes.equal_range(idstr);
+  for(auto it = range.first; it != range.second; ++it) {
+    int pagenum = it->second->getPageNum();
+    if(pagenum >= 0 && std::find(order.begin(), order.end(), pagenum) == order.end())
+      order.push_back(pagenum);
+  }
+  std::sort(order.begin(), order.end(), [&](int a, int b){ return (p0 - a + n) % n < (p0 - b + n) % n; });
   for(int ii = n; ii > 0; --ii) {
     int pagenum = (p0 + ii) % n;
+    if(!pages[pagenum]->namedNodesIndexed)
+      order.push_back(pagenum);
+  }
+  // loading a page may modify namedNodes, so we can't iterate over it here
+  for(int pagenum : order) {
     SvgNode* b = pages[pagenum]->findNamedNode(idstr);
     if(b) {
       if(pagenumout)
@@ -611,29 +1525,78 @@ SvgNode* Document::findNamedNode(const char* idstr, int* pagenumout) const
   return NULL;
 }
 
-// we'll keep this around for possible future use (e.g. supporting unlimited number of open documents), but
-//  since we've implemented a better fix for images, disable for now
-#ifdef SCRIBBLE_MEMORY_LIMIT  // mallinfo not available on Windows, Mac, iOS
-#include <malloc.h>
-#endif
+static void forEachNodeId(SvgNode* node, const std::function<void(const char*)>& fn)
+{
+  const char* id = node->xmlId();
+  if(id && id[0])
+    fn(id);
+  SvgContainerNode* container = node->asContainerNode();
+  if(container) {
+    for(SvgNode* child : container->children())
+      forEachNodeId(child, fn);
+  }
+}
 
-void Document::checkMemoryUsage(int currpage)
+// called when page is loaded or inserted
+void Document::indexNamedNodes(Page* p)
 {
-#ifdef SCRIBBLE_MEMORY_LIMIT
-  if(memoryLimit <= 0 || blockInfo.empty()) return;
-  //const size_t limit = (size_t(1) << 30);
-  struct mallinfo2 info = mallinfo2();
-  if(info.uordblks < memoryLimit) return;
-  int idxfront = 0, idxback = pages.size() - 1;
-  while(info.uordblks > memoryLimit/2) {
-    if(idxfront == currpage && idxback == currpage)
-      return;
-    // choose page most distance from currpage
-    int idx = currpage - idxfront > idxback - currpage ? idxfront++ : idxback--;
-    if(pages[idx]->dirtyCount != 0) continue;
-    pages[idx]->unload();
-    info = mallinfo2();
-    PLATFORM_LOG("Memory usage after unloading page %d: %lu", idx + 1, info.uordblks);
+  for(SvgNode* node : p->contentNode->children())
+    addNamedNodes(p, node);
+  p->namedNodesIndexed = true;
+}
+
+void Document::addNamedNodes(Page* p, SvgNode* node)
+{
+  forEachNodeId(node, [&](const char* id){ namedNodes.emplace(id, p); });
+}
+
+void Document::removeNamedNodes(Page* p, SvgNode* node)
+{
+  forEachNodeId(node, [&](const char* id){
+    auto range = namedNodes.equal_range(id);
+    for(auto it = range.first; it != range.second; ++it) {
+      if(it->second == p) {
+        namedNodes.erase(it);
+        break;
+      }
+    }
+  });
+}
+
+// If estimated memory used by loaded pages exceeds memoryLimit, unload least recently used pages until usage
+//  is below 3/4 of limit (so we aren't unloading a page every time a page is loaded).  Only clean pages that
+//  can be reloaded from file, are not referenced by undo history, and are not in use by a view (inuse(pagenum)
+//  returns true) are unloaded
+void Document::checkMemoryUsage(const std::function<bool(int)>& inuse)
+{
+  if(memoryLimit <= 0 || saveInProgress()) return;
+  size_t total = 0;
+  for(Page* p : pages) {
+    if(p->loadStatus != Page::LOAD_OK) continue;
+    // estimate is only updated when page changes
+    if(p->memUsageDirtyCount != p->dirtyCount) {
+      p->memUsage = p->estimateMemUsage();
+      p->memUsageDirtyCount = p->dirtyCount;
+    }
+    total += p->memUsage;
+  }
+  if(total <= memoryLimit) return;
+
+  std::vector<int> lru;
+  for(int ii = 0; ii < numPages(); ++ii) {
+    Page* p = pages[ii];
+    bool reloadable = (p->blockIdx >= 0 && size_t(p->blockIdx) + 1 < blockInfo.size()) || p->rawBlock
+        || !p->fileName.empty();
+    if(p->loadStatus == Page::LOAD_OK && p->dirtyCount == 0 && reloadable && !inuse(ii))
+      lru.push_back(ii);
+  }
+  std::sort(lru.begin(), lru.end(), [this](int a, int b){ return pages[a]->lastUsed < pages[b]->lastUsed; });
+  for(int idx : lru) {
+    if(total <= memoryLimit/4*3) break;
+    Page* p = pages[idx];
+    if(history->refsPage(p)) continue;
+    total -= p->memUsage;
+    p->unload();
+    PLATFORM_LOG("Unloaded page %d; estimated page memory now %lu KB\n", idx + 1, (unsigned long)(total >> 10));
   }
-#endif
 }
@@ -1,10 +1,17 @@
 #pragma once
 
+#include <atomic>
+#include <future>
+#include <thread>
+#include <unordered_map>
 #include "ulib/fileutil.h"
 #include "ulib/miniz_gzip.h"
 #include "page.h"
 #include "syncundo.h"
 
+class ThreadPool;
+struct MappedFile;
+
 struct DocPosition {
   int pagenum;
   Point pos;
@@ -24,6 +31,21 @@ struct DocViewBox {
   bool isValid() { return pagenum >= 0 && box.isValid(); }
 };
 
+// state of a page block not stored in bgz index, needed to rewrite page in place
+struct BgzBlockState {
+  Dim y = -1;  // SVG position of page written to block
+  uint32_t padding = 0;  // unused bytes at end of block
+};
+
+// compressed page block; crc_32 and len are for this block alone
+struct BgzBlock {
+  MemStream strm;
+  uint32_t crc_32 = MINIZ_GZ_CRC32_INIT;
+  int len = 0;  // uncompressed length, < 0 on error
+  uint32_t padding = 0;  // bytes of whitespace stored blocks at end
+  bool ok = true;
+};
+
 class Document {
 public:
   std::vector<Page*> pages;
@@ -32,9 +54,19 @@ public:
   int autoSaveSerialNum = 0;
   bool bookmarksDirty = false;
   pugi::xml_document xmldoc;
+  // id -> page for every named node (i.e. link target), one entry per occurrence, so links can be resolved w/o
+  //  loading every page; saved in bgz footer.  Pages w/o Page::namedNodesIndexed set (e.g. from older files)
+  //  have no entries and must be searched directly
+  std::unordered_multimap<std::string, Page*> namedNodes;
+  // index in pages for each page SvgDocument, for pageForElement(); entries may be stale (pages inserted or
+  //  removed, page reloaded or deleted) so index is checked against pages before use - a Page pointer could
+  //  be dangling
+  mutable std::unordered_map<const SvgDocument*, size_t> docPages;
 
   std::unique_ptr<IOStream> blockStream;
   std::vector<bgz_block_info_t> blockInfo;
+  std::vector<BgzBlockState> blockState;  // parallel to blockInfo
+  std::unique_ptr<MappedFile> blockMap;  // read-only mapping of blockStream file for loading pages
 
   enum loadresult_t {LOAD_OK=0, LOAD_FATAL=-1, LOAD_NONFATAL=-2, LOAD_EMPTYDOC=-3, LOAD_NEWERVERSION=-4, LOAD_NONWRITE=-5};
   // document format version
@@ -42,33 +74,65 @@ public:
   // save flags
   typedef unsigned int saveflags_t;
   static constexpr saveflags_t SAVE_NORMAL = 0x0, SAVE_FORCE = 0x1, SAVE_MULTIFILE = 0x2, SAVE_COPY = 0x4,
-      /*SAVE_AUTO_BACKUP = 0x8,*/ SAVE_BGZ_PARTIAL = 0x10;
+      /*SAVE_AUTO_BACKUP = 0x8,*/ SAVE_BGZ_PARTIAL = 0x10, SAVE_BACKGROUND = 0x20, SAVE_BINARY_PATHS = 0x40;
   static size_t memoryLimit;
+  uint64_t pageUseCount = 0;  // incremented each time a page is used, for LRU unloading
 
   Document();
   ~Document();
   int insertPage(Page* p, int where = -1);
   Page* deletePage(int where);  // , bool delstrokes = false);
-  bool ensurePagesLoaded();
+  bool ensurePagesLoaded(const std::function<bool(int, int)>& progress = NULL);
   bool checkAndClearErrors();
   pugi::xml_node resetConfigNode(pugi::xml_node newcfg = pugi::xml_node());
   pugi::xml_node getConfigNode();
 
   SvgNode* findNamedNode(const char* idstr, int* pagenumout = NULL) const;
+  void indexNamedNodes(Page* p);
+  void addNamedNodes(Page* p, SvgNode* node);
+  void removeNamedNodes(Page* p, SvgNode* node);
   Page* pageForElement(const Element* s) const;
   int pageNumForElement(const Element* s) const;
+  void updatePageNums(size_t first = 0);
 
   bool save(IOStream* outstrm, const char* thumb, saveflags_t flags = SAVE_NORMAL);
-  loadresult_t load(IOStream* instrm, bool delayload = false);
-  loadresult_t load(const pugi::xml_document& doc, const char* path= "", bool delayload = false, bool ok = true);
+  // progress, if given, is passed to ensurePagesLoaded() for multi-file (legacy HTML) documents w/o delayload
+  loadresult_t load(IOStream* instrm, bool delayload = false, const std::function<bool(int, int)>& progress = NULL);
+  loadresult_t load(const pugi::xml_document& doc, const char* path= "", bool delayload = false, bool ok = true,
+      const std::function<bool(int, int)>& progress = NULL);
   bool deleteFiles();
   bool isModified() const;
   bool isEmptyFile() const;
   int numPages() const { return int(pages.size()); }
 
   bool saveBgz(IOStream* outstrm, const char* thumb, saveflags_t flags);
+  bool saveBackground(const char* thumb, saveflags_t flags, std::function<void()> onDone = NULL);
+  bool waitForSave();
+  bool saveInProgress() const { return saveThread != NULL; }
   bool loadBgzPage(Page* page);
+  MappedFile* mapBlockStream();
+  bool saveSafeBlock(const Page* p) const;
+  bool startPageLoad(Page* p, IOStream* blocksrc);
+  bool loadPrefetched(Page* page);
+  void prefetchPages(int first, int last);
   Document::loadresult_t loadBgzDoc(IOStream* instrm);
+  static std::vector<bgz_block_info_t> readBgzIndex(IOStream* strm);
   const char* fileName() const { return blockStream ? blockStream->name() : ""; }
-  void checkMemoryUsage(int currpage);
+  void checkMemoryUsage(const std::function<bool(int)>& inuse);
+
+  static ThreadPool* workerPool();
+  static int numWorkers;
+
+  // background save state
+  std::unique_ptr<std::thread> saveThread;
+  std::unique_ptr<Document> saveSnapshot;
+  std::vector<Page*> savePages;  // original pages corresponding to saveSnapshot->pages
+  std::vector<int> saveDirtyCounts;  // Page.dirtyCount of savePages when snapshot was taken
+  int saveDocDirtyCount = 0;
+  uint32_t saveSafeEnd = 0;  // file offset before which background save writes no blocks
+  bool saveResult = true;
+  std::atomic_bool saveFinished{false};
+
+  // unloaded pages being inflated and parsed on worker threads; attached by loadPrefetched()
+  std::unordered_map< Page*, std::future< std::unique_ptr<SvgDocument> > > prefetched;
 };
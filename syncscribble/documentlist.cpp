@@ -1,5 +1,12 @@
 #include <time.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
 #include "documentlist.h"
+#include "docindex.h"
+#include "docconvert.h"
 
 #include "scribbleapp.h"
 #include "scribbledoc.h"
@@ -13,9 +20,15 @@ static const char* docListWindowSVG = R"#(
 </svg>
 )#";
 
-DocumentList::DocumentList(const char* root, const char* temp) : Window(createWindowNode(docListWindowSVG))
+DocumentList::DocumentList(const char* root, const char* temp, const char* thumbcache, const char* indexfile)
+    : Window(createWindowNode(docListWindowSVG))
 {
   trashPath = temp;
+  thumbCacheDir = thumbcache;
+  if(thumbcache[0])
+    createPath(thumbcache);
+  if(indexfile[0])
+    docIndex.reset(new DocIndex(root, indexfile, thumbcache));
   docFileExt = ScribbleApp::cfg->String("docFileExt");
   iconWidth = ScribbleApp::cfg->Int("thumbnailSize", 140) * ScribbleApp::getPreScale();
 
@@ -114,6 +127,15 @@ void DocumentList::createUI()
   mainToolbar->addWidget(breadCrumbs[1]);
   mainToolbar->addWidget(breadCrumbs[0]);
   mainToolbar->addWidget(stretch);
+  // search title, tags, and file name of all indexed documents under docRoot
+  if(docIndex) {
+    searchEdit = createTextEdit(160);
+    searchEdit->onChanged = [this](const char* s){
+      searchQuery = StringRef(s).trimmed().toString();
+      refresh();
+    };
+    mainToolbar->addWidget(searchEdit);
+  }
   mainToolbar->addWidget(saveHereBtn);
   mainToolbar->addWidget(newDocBtn);
   mainToolbar->addWidget(newFolderBtn);
@@ -341,6 +363,9 @@ void DocumentList::setup(Window* parent, Mode_t mode, const char* exts, bool can
 //#endif
 
   setWinBounds(PLATFORM_MOBILE ? parent->winBounds() : parent->winBounds().pad(-40));
+  // incremental, so only documents changed since last time doc list was shown are read
+  if(docIndex)
+    docIndex->update();
   // we want _NET_WM_WINDOW_TYPE_DIALOG but this isn't possible with SDL
   //svgGui->showWindow(this, parent, true, SDL_WINDOW_RESIZABLE|SDL_WINDOW_UTILITY);
 
@@ -356,12 +381,496 @@ void DocumentList::finish(Result_t res)
 {
   hideUndo();
   clearClipboard();
+  clearListItems();
+  if(listTimer)
+    gui()->removeTimer(listTimer);
+  listTimer = NULL;
   gui()->closeWindow(this);
   result = res;
   if(onFinished)
     onFinished(res);
 }
 
+static std::string thumbCacheName(const std::string& path)
+{
+  uint64_t hash = 0xcbf29ce484222325ULL;  // FNV-1a
+  for(char c : path)
+    hash = (hash ^ (unsigned char)c) * 0x100000001b3ULL;
+  return fstring("%016llx.thumb", (unsigned long long)hash);
+}
+
+// box filter downscale - thumbnails are only ever reduced for display
+static Image downscaleImage(Image& src, int w, int h)
+{
+  Image dst(w, h);
+  const unsigned int* in = src.pixels();
+  unsigned int* out = dst.pixels();
+  for(int y = 0; y < h; ++y) {
+    int y0 = (y*src.height)/h, y1 = std::max(y0 + 1, ((y + 1)*src.height)/h);
+    for(int x = 0; x < w; ++x) {
+      int x0 = (x*src.width)/w, x1 = std::max(x0 + 1, ((x + 1)*src.width)/w);
+      uint32_t sum[4] = {0, 0, 0, 0};
+      for(int sy = y0; sy < y1; ++sy) {
+        for(int sx = x0; sx < x1; ++sx) {
+          unsigned int c = in[sy*src.width + sx];
+          for(int ch = 0; ch < 4; ++ch)
+            sum[ch] += (c >> (8*ch)) & 0xFF;
+        }
+      }
+      uint32_t n = (y1 - y0)*(x1 - x0);
+      out[y*w + x] = (sum[0]/n) | ((sum[1]/n) << 8) | ((sum[2]/n) << 16) | ((sum[3]/n) << 24);
+    }
+  }
+  return dst;
+}
+
+// called on DocumentList worker thread
+static Image getThumbnail(const FSPath& fileinfo, int maxwidth, const FSPath& cachedir)
+{
+  if(cachedir.isEmpty())
+    return ScribbleDoc::extractThumbnail(fileinfo.c_str());
+
+  std::string path = fileinfo.path;
+  FSPath cachefile = cachedir.child(thumbCacheName(path));
+  ThumbCacheHeader hdr;
+  hdr.maxWidth = maxwidth;
+  hdr.mtime = getFileMTime(fileinfo);
+  hdr.fsize = getFileSize(fileinfo);
+  hdr.pathLen = path.size();
+  {
+    ThumbCacheHeader cached;
+    std::string cachedpath(path.size(), '\0');
+    FileStream strm(cachefile.c_str(), "rb");
+    if(strm.is_open() && strm.read((char*)&cached, sizeof(cached)) == sizeof(cached)
+        && memcmp(cached.magic, hdr.magic, 4) == 0 && cached.maxWidth == hdr.maxWidth && cached.mtime == hdr.mtime
+        && cached.fsize == hdr.fsize && cached.pathLen == hdr.pathLen && cached.width <= 4096 && cached.height <= 4096
+        && strm.read(&cachedpath[0], path.size()) == path.size() && cachedpath == path) {
+      if(cached.width <= 0 || cached.height <= 0)
+        return Image(0, 0);
+      Image img(cached.width, cached.height);
+      size_t len = size_t(cached.width)*cached.height*4;
+      if(strm.read((char*)img.pixels(), len) == len)
+        return img;
+    }
+  }
+
+  Image thumb = ScribbleDoc::extractThumbnail(fileinfo.c_str());
+  Image icon = !thumb.isNull() && thumb.width > maxwidth ?
+      downscaleImage(thumb, maxwidth, std::max(1, (thumb.height*maxwidth)/thumb.width)) : std::move(thumb);
+  // documents w/o thumbnail are cached too so they aren't inflated again
+  hdr.width = icon.isNull() ? 0 : icon.width;
+  hdr.height = icon.isNull() ? 0 : icon.height;
+  // written to temp file first so a reader never sees a partially written cache file
+  std::string tempfile = cachefile.path + ".tmp";
+  bool ok;
+  {
+    FileStream strm(tempfile.c_str(), "wb");
+    size_t len = size_t(hdr.width)*hdr.height*4;
+    ok = strm.is_open() && strm.write((const char*)&hdr, sizeof(hdr)) == sizeof(hdr)
+        && strm.write(path.data(), path.size()) == path.size()
+        && (len == 0 || strm.write((const char*)icon.pixels(), len) == len);
+  }
+  if(!ok || !moveFile(FSPath(tempfile), cachefile))
+    removeFile(tempfile);
+  return icon;
+}
+
+static bool isWriteDoc(const FSPath& fileinfo, const std::string& exts)
+{
+  if(fileinfo.name().substr(0,1) == ".")  // don't crash if name is empty
+    return false;
+  // don't show old multi-file doc page files ending with "_pageXXX.svg"
+  if(fileinfo.extension() == "svg" && StringRef(fileinfo.baseName()).chop(3).endsWith("_page"))
+    return false;
+  return fileinfo.isDir() || containsWord(exts.c_str(), fileinfo.extension().c_str());
+}
+
+// item details found by background listing
+struct DocListInfo
+{
+  size_t idx;
+  Timestamp mtime;
+  long fsize;  // number of items for folder
+  int numPages;
+};
+
+struct DocListThumb
+{
+  size_t idx;
+  std::unique_ptr<Image> image;  // NULL if document has no thumbnail
+};
+
+struct DocListTask
+{
+  std::atomic_bool cancel{false};
+  std::mutex mutex;
+  std::condition_variable cond;
+  std::vector<DocListInfo> results;  // guarded by mutex
+  std::vector<DocListThumb> thumbs;  // guarded by mutex
+  std::deque<size_t> thumbRequests;  // entries needing thumbnails, most urgent first; guarded by mutex
+  bool done = false;  // details found for all files; guarded by mutex
+};
+
+// stat and count folder items for listed files on a separate thread, in display order, passing results back in
+//  small batches so list can be shown immediately with placeholders; thumbnails are only loaded for entries
+//  requested by DocumentList::updateThumbnails() (those near viewport), which take priority over details.
+//  Worker waits for more requests once details are done and exits when task is cancelled
+static void docListWorker(std::shared_ptr<DocListTask> task, std::vector<FSPath> files, std::string exts,
+    bool details, int thumbwidth, FSPath cachedir, std::shared_ptr<DocIndex> index)
+{
+  std::vector<DocListInfo> batch;
+  Timestamp batchtime = mSecSinceEpoch();
+  size_t next = 0;
+  while(!task->cancel) {
+    size_t thumbidx = SIZE_MAX;
+    {
+      std::unique_lock<std::mutex> lock(task->mutex);
+      // limit lock traffic while still delivering first results quickly
+      if(!batch.empty() && (next >= files.size() || mSecSinceEpoch() - batchtime > 20)) {
+        for(DocListInfo& b : batch)
+          task->results.push_back(std::move(b));
+        batch.clear();
+        batchtime = mSecSinceEpoch();
+      }
+      if(next >= files.size()) {
+        task->done = true;
+        task->cond.wait(lock, [&task](){ return task->cancel || !task->thumbRequests.empty(); });
+      }
+      if(task->cancel)
+        break;
+      if(!task->thumbRequests.empty()) {
+        thumbidx = task->thumbRequests.front();
+        task->thumbRequests.pop_front();
+      }
+    }
+    if(thumbidx < files.size()) {
+      Image thumbnail = getThumbnail(files[thumbidx], thumbwidth, cachedir);
+      DocListThumb thumb = {thumbidx, NULL};
+      if(!thumbnail.isNull())
+        thumb.image.reset(new Image(std::move(thumbnail)));
+      std::lock_guard<std::mutex> lock(task->mutex);
+      task->thumbs.push_back(std::move(thumb));
+      continue;
+    }
+    if(thumbidx != SIZE_MAX)
+      continue;
+    const FSPath& fileinfo = files[next];
+    DocListInfo info = {next++, 0, 0, 0};
+    if(!details)
+      continue;
+    if(fileinfo.isDir()) {
+      std::vector<std::string> contents = lsDirectory(fileinfo);
+      info.fsize = std::count_if(contents.begin(), contents.end(),
+          [&exts](const std::string& f){ return isWriteDoc(FSPath(f), exts); });
+    }
+    else {
+      info.mtime = getFileMTime(fileinfo);
+      info.fsize = getFileSize(fileinfo);
+      // page count is only shown if index is up to date for this file
+      DocIndexEntry indexed;
+      if(index && index->getEntry(fileinfo.path, &indexed) && indexed.mtime == info.mtime)
+        info.numPages = indexed.numPages;
+    }
+    batch.push_back(info);
+  }
+}
+
+Rect DocumentList::iconSize() const
+{
+  return iconWidth < 80 ? Rect::wh(30, 50) : Rect::wh(iconWidth, (5*iconWidth)/3);
+}
+
+static std::string mtimeString(Timestamp t)
+{
+  char timestr[64];
+  time_t mtime = t;
+  //Timestamp ago = mSecSinceEpoch()/1000 - mtimes[ii];
+  const char* timefmt = "%d %b %Y %H:%M";  //ago < 60*60*24*364 ? "%d %b %H:%M" : "%d %b %Y %H:%M";
+  strftime(timestr, sizeof(timestr), timefmt, localtime(&mtime));
+  return timestr;
+}
+
+static std::string fsizeString(double fsize)
+{
+  if(fsize >= 999500)
+    return fstring("%.3g MB", fsize/1E6);
+  if(fsize >= 999)
+    return fstring("%.3g KB", fsize/1E3);
+  return fstring("%.0f B", fsize);
+}
+
+// apply results from background listing to list entries; returns false once details have been found for all
+//  entries (worker continues to load requested thumbnails)
+bool DocumentList::updateListItems()
+{
+  if(!listTask)
+    return false;
+  std::vector<DocListInfo> results;
+  std::vector<DocListThumb> thumbs;
+  bool done = false;
+  {
+    std::lock_guard<std::mutex> lock(listTask->mutex);
+    results.swap(listTask->results);
+    thumbs.swap(listTask->thumbs);
+    done = listTask->done;
+  }
+  for(DocListInfo& info : results) {
+    DocListEntry& entry = listEntries[info.idx];
+    entry.mtime = info.mtime;
+    entry.fsize = info.fsize;
+    entry.numPages = info.numPages;
+  }
+  // thumbnails for entries scrolled out of range since they were requested are discarded
+  for(DocListThumb& thumb : thumbs) {
+    DocListEntry& entry = listEntries[thumb.idx];
+    if(thumb.image && !entry.thumbnail && int(thumb.idx) >= thumbFirst && int(thumb.idx) < thumbLast)
+      entry.thumbnail = new SvgImage(std::move(*thumb.image), iconSize());
+  }
+  // rebind visible items that got new details
+  if(!results.empty() || !thumbs.empty()) {
+    for(DocListItem& item : listItems) {
+      if(item.entry >= 0)
+        bindItem(item, item.entry, true);
+    }
+  }
+  return !done;
+}
+
+// thumbnails are only kept for entries in bound range plus one screen on either side; others are released
+//  and requested again if scrolled back near viewport (worker then reads them from thumbnail cache).  Pending
+//  requests are replaced so that worker always loads visible thumbnails first
+void DocumentList::updateThumbnails()
+{
+  int n = listEntries.size();
+  int margin = boundLast - boundFirst;
+  int first = std::max(0, boundFirst - margin), last = std::min(n, boundLast + margin);
+  for(int ii = thumbFirst; ii < thumbLast; ++ii) {
+    if(ii < first || ii >= last) {
+      delete listEntries[ii].thumbnail;
+      listEntries[ii].thumbnail = NULL;
+      listEntries[ii].thumbRequested = false;
+    }
+  }
+  thumbFirst = first;
+  thumbLast = last;
+  if(!listTask)
+    return;
+  std::deque<size_t> requests;
+  {
+    std::lock_guard<std::mutex> lock(listTask->mutex);
+    requests.swap(listTask->thumbRequests);
+  }
+  for(size_t idx : requests)
+    listEntries[idx].thumbRequested = false;
+  requests.clear();
+  auto request = [&](int idx){
+    DocListEntry& entry = listEntries[idx];
+    if(!entry.thumbRequested && !entry.fileinfo.isDir()
+        && containsWord("svg svgz html htm", entry.fileinfo.extension().c_str())) {
+      entry.thumbRequested = true;
+      requests.push_back(idx);
+    }
+  };
+  // visible entries first, then those below (usual scroll direction), then those above
+  for(int ii = boundFirst; ii < boundLast; ++ii)
+    request(ii);
+  for(int ii = boundLast; ii < last; ++ii)
+    request(ii);
+  for(int ii = boundFirst - 1; ii >= first; --ii)
+    request(ii);
+  if(requests.empty())
+    return;
+  {
+    std::lock_guard<std::mutex> lock(listTask->mutex);
+    listTask->thumbRequests.swap(requests);
+  }
+  listTask->cond.notify_one();
+}
+
+DocListItem DocumentList::createItem()
+{
+  bool uselist = iconWidth < 80;
+  DocListItem item;
+  item.button = new Button(uselist ? listItemProto->clone() : gridItemProto->clone());
+  // tentative approach to handling right click is to wrap sdlEvent with second event handler for
+  //  right click/long press; we expect right click handlers to be much less numerous than left click handlers
+  if(currMode != CHOOSE_DOC && currMode != CHOOSE_IMAGE) {
+    SvgGui::setupRightClick(item.button, [this](SvgGui* gui, Widget* widget, Point p){
+      //listView->clearSelection();
+      contextMenuItem = widget->userData<FSPath>();
+      contextMenuCopy->setVisible(!contextMenuItem.isDir());  // or setEnabled() to disable instead of hide?
+      contextMenuOpenCopy->setVisible(!contextMenuItem.isDir());
+      //widget->node->addClass("pressed");  -- how to clear pressed when context menu closed?
+      gui->showContextMenu(contextMenu, p);
+    });
+  }
+  item.button->onClicked = [this, item]() {
+    const FSPath& fileinfo = item.button->userData<FSPath>();
+    hideUndo();
+    if(fileinfo.isDir())
+      setCurrDir(fileinfo.c_str());
+    else {
+      selectedFile = fileinfo.c_str();
+      finish(EXISTING_DOC);
+    }
+  };
+  item.iconContainer = item.button->selectFirst(".image-container")->containerNode();
+  auto textBox = [&item](const char* sel) {
+    SvgNode* textnode = item.button->containerNode()->selectFirst(sel);
+    return textnode ? new TextBox(static_cast<SvgText*>(textnode)) : NULL;
+  };
+  item.title = textBox(".title-text");
+  item.mtime = uselist ? textBox(".mtime-text") : NULL;
+  item.fsize = uselist ? textBox(".fsize-text") : NULL;
+  // insert before bottom spacer
+  listView->addWidget(item.button);
+  if(bottomSpacer) {
+    listView->containerNode()->removeChild(bottomSpacer);
+    listView->containerNode()->addChild(bottomSpacer);
+  }
+  return item;
+}
+
+// thumbnail nodes are owned by entry, so are detached rather than deleted when item is rebound
+void DocumentList::unbindItem(DocListItem& item)
+{
+  SvgNode* thumbnail = item.entry >= 0 ? listEntries[item.entry].thumbnail : NULL;
+  while(!item.iconContainer->children().empty()) {
+    SvgNode* icon = item.iconContainer->children().front();
+    item.iconContainer->removeChild(icon);
+    if(icon != thumbnail)
+      delete icon;
+  }
+  item.entry = -1;
+}
+
+void DocumentList::bindItem(DocListItem& item, int idx, bool force)
+{
+  if(item.entry == idx && !force)
+    return;
+  unbindItem(item);
+  item.button->setVisible(idx >= 0);
+  if(idx < 0)
+    return;
+  item.entry = idx;
+  DocListEntry& entry = listEntries[idx];
+  const FSPath& fileinfo = entry.fileinfo;
+  item.button->setUserData<FSPath>(fileinfo);
+  item.button->setEnabled((currMode != SAVE_DOC && currMode != SAVE_PDF) || fileinfo.isDir());  // prevent file selection in
+  // generic icon is shown until thumbnail, if any, is available
+  if(entry.thumbnail)
+    item.iconContainer->addChild(entry.thumbnail);
+  else
+    item.iconContainer->addChild(fileinfo.isDir() ? folderUseNode->clone() : fileUseNode->clone());
+
+  // ellipsize name as needed
+  std::string s = fileinfo.extension() == docFileExt ? fileinfo.baseName() : fileinfo.fileName();
+  item.title->setText(s.c_str());
+  if(!item.mtime)
+    SvgPainter::elideText(static_cast<SvgText*>(item.title->node), iconWidth);
+  else if(entry.fsize < 0) {
+    item.mtime->setText("");
+    item.fsize->setText("");
+  }
+  else if(fileinfo.isDir()) {
+    item.mtime->setText(entry.fsize == 1 ? _("1 item") : fstring(_("%d items"), entry.fsize).c_str());
+    item.fsize->setText("");
+  }
+  else {
+    item.mtime->setText(mtimeString(entry.mtime).c_str());
+    std::string fsize = fsizeString(entry.fsize);
+    if(entry.numPages > 0)
+      fsize = (entry.numPages == 1 ? _("1 page") : fstring(_("%d pages"), entry.numPages)) + "   " + fsize;
+    item.fsize->setText(fsize.c_str());
+  }
+}
+
+static void setListSpacer(SvgContainerNode* list, SvgNode*& spacer, Dim w, Dim h, bool front)
+{
+  if(spacer) {
+    list->removeChild(spacer);
+    delete spacer;
+  }
+  spacer = new SvgRect(Rect::wh(w, h));
+  spacer->setAttr<color_t>("fill", Color::NONE);
+  list->addChild(spacer, front && !list->children().empty() ? list->children().front() : NULL);
+}
+
+// only items for entries in or near the viewport exist; offscreen rows are replaced by spacers so scroll
+//  range is unchanged; all items have the same size, so visible range is found directly from scroll position
+void DocumentList::updateVisibleItems(bool force)
+{
+  Rect view = scrollWidget->node->bounds();
+  if(!view.isValid())
+    view = winBounds().toSize();
+  Rect content = listView->node->bounds();
+  bool uselist = iconWidth < 80;
+  // margin must match listItemProtoSVG and gridItemProtoSVG
+  Dim marginx = uselist ? 5 : 20, marginy = uselist ? 0 : 20;
+  for(DocListItem& item : listItems) {
+    Rect b = item.entry >= 0 ? item.button->node->bounds() : Rect();
+    if(b.isValid()) {
+      if(b.height() + 2*marginy != itemPitch)
+        force = true;
+      itemPitch = b.height() + 2*marginy;
+      break;
+    }
+  }
+  if(itemPitch <= 0)
+    itemPitch = uselist ? 50 : iconSize().height() + 80;  // estimate until an item has been laid out
+  int n = listEntries.size();
+  int ncols = uselist ? 1 : std::max(1, int(view.width()/(iconWidth + 2*marginx)));
+  int nrows = (n + ncols - 1)/ncols;
+  Dim top = content.isValid() ? view.top - content.top : 0;
+  int firstrow = std::max(0, int(top/itemPitch) - 1);
+  int lastrow = std::max(firstrow - 1, std::min(nrows - 1, int((top + view.height())/itemPitch) + 1));
+  int first = firstrow*ncols, last = std::min(n, (lastrow + 1)*ncols);
+  if(!force && first == boundFirst && last == boundLast)
+    return;
+  boundFirst = first;
+  boundLast = last;
+
+  while(int(listItems.size()) < last - first)
+    listItems.push_back(createItem());
+  for(size_t ii = 0; ii < listItems.size(); ++ii)
+    bindItem(listItems[ii], first + int(ii) < last ? first + int(ii) : -1);
+  SvgContainerNode* list = listView->containerNode();
+  setListSpacer(list, topSpacer, view.width(), firstrow*itemPitch, true);
+  setListSpacer(list, bottomSpacer, view.width(), std::max(0, nrows - lastrow - 1)*itemPitch, false);
+  updateThumbnails();
+}
+
+void DocumentList::clearListItems()
+{
+  if(listTask) {
+    {
+      std::lock_guard<std::mutex> lock(listTask->mutex);
+      listTask->cancel = true;
+    }
+    listTask->cond.notify_all();
+  }
+  listTask.reset();
+  for(DocListItem& item : listItems)
+    unbindItem(item);
+  listItems.clear();
+  for(DocListEntry& entry : listEntries)
+    delete entry.thumbnail;
+  listEntries.clear();
+  for(SvgNode** spacer : {&topSpacer, &bottomSpacer}) {
+    if(*spacer) {
+      listView->containerNode()->removeChild(*spacer);
+      delete *spacer;
+      *spacer = NULL;
+    }
+  }
+  // TODO: reuse existing nodes instead of always deleting and recreating
+  if(gui())
+    gui()->deleteContents(listView, ".listitem");
+  boundFirst = boundLast = -1;
+  thumbFirst = thumbLast = 0;
+  itemPitch = 0;
+}
+
 void DocumentList::setCurrDir(const char* path)
 {
   FSPath pathinfo(path);
@@ -376,63 +885,39 @@ void DocumentList::setCurrDir(const char* path)
   // can't paste into read-only folder, obviously
   pasteButton->setEnabled(writable);
 
-  // TODO: reuse existing nodes instead of always deleting and recreating
-  if(gui())
-    gui()->deleteContents(listView, ".listitem");
+  // also cancels any listing in progress - worker thread only holds a reference to the task
+  clearListItems();
 
   bool uselist = iconWidth < 80;
   listView->node->setAttribute("flex-direction", uselist ? "column" : "row");
   listView->node->setAttribute("flex-wrap", uselist ? "nowrap" : "wrap");
 
-  Rect iconSize = uselist ? Rect::wh(30, 50) : Rect::wh(iconWidth, (5*iconWidth)/3);
-  fileUseNode->setViewport(iconSize);
-  folderUseNode->setViewport(iconSize);
-
-  auto itemRightClick = [this](SvgGui* gui, Widget* widget, Point p){
-    //listView->clearSelection();
-    contextMenuItem = widget->userData<FSPath>();
-    contextMenuCopy->setVisible(!contextMenuItem.isDir());  // or setEnabled() to disable instead of hide?
-    contextMenuOpenCopy->setVisible(!contextMenuItem.isDir());
-    //widget->node->addClass("pressed");  -- how to clear pressed when context menu closed?
-    gui->showContextMenu(contextMenu, p);
-  };
-
-  auto isWriteDoc = [this](const FSPath& fileinfo){
-    if(fileinfo.name().substr(0,1) == ".")  // don't crash if name is empty
-      return false;
-    // don't show old multi-file doc page files ending with "_pageXXX.svg"
-    if(fileinfo.extension() == "svg" && StringRef(fileinfo.baseName()).chop(3).endsWith("_page"))
-      return false;
-    return fileinfo.isDir() || containsWord(fileExts.c_str(), fileinfo.extension().c_str());
-  };
+  Rect iconsize = iconSize();
+  fileUseNode->setViewport(iconsize);
+  folderUseNode->setViewport(iconsize);
 
   // update contents
   enum sortBy_t {SORT_NAME, SORT_MTIME};
   sortBy_t sortBy = ScribbleApp::cfg->Int("docListSort") == 1 ? SORT_MTIME : SORT_NAME;
-  std::vector<std::string> allfiles = lsDirectory(pathinfo);
-  // extract folders and files we support
-  std::vector<std::string> files;
+  // if searching, list matching documents from index (anywhere under docRoot) instead of contents of currDir
+  bool searching = docIndex && !searchQuery.empty();
+  std::vector<std::string> allfiles = searching ? docIndex->search(searchQuery.c_str()) : lsDirectory(pathinfo);
+  // extract folders and files we support; other details are filled in by docListWorker()
+  std::vector<FSPath> fileinfos;
+  std::vector<std::string> files;  // names for sorting
   std::vector<Timestamp> mtimes;
-  std::vector<long> fsizes;
   for(const std::string& file : allfiles) {
     if(file.empty() || file.front() == '.')
       continue;
-    FSPath fileinfo = pathinfo.child(file);
-    if(!isWriteDoc(fileinfo))
+    FSPath fileinfo = searching ? FSPath(file) : pathinfo.child(file);
+    if(!isWriteDoc(fileinfo, fileExts) || (searching && !fileinfo.exists()))
       continue;
-    files.emplace_back(file);
+    fileinfos.push_back(fileinfo);
+    files.emplace_back(searching ? fileinfo.fileName() : file);
     hasLegacyDocs = hasLegacyDocs || (fileinfo.extension() == "html"
         && fileinfo.baseName().size() == 13 && fileinfo.baseName()[0] == '1');
-    if(sortBy == SORT_MTIME || uselist)
+    if(sortBy == SORT_MTIME)
       mtimes.push_back(fileinfo.isDir() ? 0 : getFileMTime(fileinfo));
-    if(uselist) {
-      if(fileinfo.isDir()) {
-        std::vector<std::string> contents = lsDirectory(fileinfo);
-        fsizes.push_back(std::count_if(contents.begin(), contents.end(), isWriteDoc));
-      }
-      else
-        fsizes.push_back(getFileSize(fileinfo));
-    }
   }
 
   // sort indices instead of names themselves (i.e., argsort)
@@ -448,75 +933,26 @@ void DocumentList::setCurrDir(const char* path)
     return toLower(files[a]) < toLower(files[b]);  // always case-insensitive
   });
 
-  for(size_t ii : indices) {
-    const std::string& filename = files[ii];
-    FSPath fileinfo = pathinfo.child(filename);
-    Button* item = new Button(uselist ? listItemProto->clone() : gridItemProto->clone());
-    item->setUserData<FSPath>(fileinfo);
-    item->onClicked = [this, fileinfo](){
-      //const FSPath& fileinfo = widget->userData<FSPath>();
-      hideUndo();
-      if(fileinfo.isDir())
-        setCurrDir(fileinfo.c_str());
-      else {
-        selectedFile = fileinfo.c_str();
-        finish(EXISTING_DOC);
-      }
-    };
-    item->setEnabled((currMode != SAVE_DOC && currMode != SAVE_PDF) || fileinfo.isDir());  // prevent file selection in
-    // tentative approach to handling right click is to wrap sdlEvent with second event handler for
-    //  right click/long press; we expect right click handlers to be much less numerous than left click handlers
-    if(currMode != CHOOSE_DOC && currMode != CHOOSE_IMAGE)
-      SvgGui::setupRightClick(item, itemRightClick);
-
-    SvgContainerNode* container = item->selectFirst(".image-container")->containerNode();
-    // TODO: provide SvgImage::setImage() and implement move assignment operator for Image
-    if(fileinfo.isDir())
-      container->addChild(folderUseNode->clone());
-    else if(!containsWord("svg svgz html htm", fileinfo.extension().c_str()))  //fileinfo.extension() != docFileExt)
-      container->addChild(fileUseNode->clone());
-    else {
-      Image thumbnail = ScribbleDoc::extractThumbnail(fileinfo.c_str());
-      if(!thumbnail.isNull())
-        container->addChild(new SvgImage(std::move(thumbnail), iconSize));
-      else
-        container->addChild(fileUseNode->clone());
-    }
-
-    listView->addWidget(item); //structureNode()->addChild(item->node);
-
-    // ellipsize name as needed - have to do this after adding widget to list so style is correct
-    std::string s = fileinfo.extension() == docFileExt ? fileinfo.baseName() : fileinfo.fileName();
-    SvgText* textnode = static_cast<SvgText*>(item->containerNode()->selectFirst(".title-text"));
-    textnode->addText(s.c_str());
-    if(!uselist)
-      SvgPainter::elideText(textnode, iconWidth);
-
-    if(uselist) {
-      SvgText* mtimenode = static_cast<SvgText*>(item->containerNode()->selectFirst(".mtime-text"));
-      if(fileinfo.isDir())
-        mtimenode->addText(fsizes[ii] == 1 ? _("1 item") : fstring(_("%d items"), fsizes[ii]).c_str());
-      else {
-        // last modified time
-        char timestr[64];
-        time_t mtime = mtimes[ii];
-        //Timestamp ago = mSecSinceEpoch()/1000 - mtimes[ii];
-        const char* timefmt = "%d %b %Y %H:%M";  //ago < 60*60*24*364 ? "%d %b %H:%M" : "%d %b %Y %H:%M";
-        strftime(timestr, sizeof(timestr), timefmt, localtime(&mtime));
-        mtimenode->addText(timestr);
-        SvgText* fsizenode = static_cast<SvgText*>(item->containerNode()->selectFirst(".fsize-text"));
-        // file size
-        double fsize = fsizes[ii];
-        if(fsize >= 999500)
-          fsizenode->addText(fstring("%.3g MB", fsize/1E6).c_str());
-        else if(fsize >= 999)
-          fsizenode->addText(fstring("%.3g KB", fsize/1E3).c_str());
-        else
-          fsizenode->addText(fstring("%.0f B", fsize).c_str());
-      }
-    }
-
+  std::vector<FSPath> listfiles;
+  for(size_t ii : indices)
+    listfiles.push_back(fileinfos[ii]);
+  listEntries.resize(listfiles.size());
+  for(size_t ii = 0; ii < listfiles.size(); ++ii)
+    listEntries[ii].fileinfo = listfiles[ii];
+  updateVisibleItems(true);
+
+  if(!listfiles.empty()) {
+    listTask.reset(new DocListTask);
+    int thumbwidth = int(iconsize.width()*ScribbleApp::gui->paintScale + 0.5);
+    std::thread(docListWorker, listTask, std::move(listfiles), fileExts, uselist, thumbwidth, thumbCacheDir, docIndex).detach();
+    updateThumbnails();
   }
+  // visible range is checked periodically since kinetic scrolling happens without any input events
+  listTimer = ScribbleApp::gui->setTimer(50, this, listTimer, [this]() {
+    updateListItems();
+    updateVisibleItems();
+    return 50;
+  });
 
   // reset scroll if different folder, otherwise, just ensure position is still valid
   if(currDir == pathinfo)
@@ -875,15 +1311,14 @@ NewDocDialog::NewDocDialog(const char* title, const FSPath& fsinfo, bool newdoc)
   cancelBtn = addButton(_("Cancel"), [this](){ finish(CANCELLED); });
 }
 
-//#include <thread>
-// This absolute disaster is due to the fact that we can't save a document on a thread, because we need bounds
-//  for links (if nothing else), and we can't calculate bounds on a thread, because we need nanovg context for
-//  bounds calculation, primarily for text bounds calculation
+// Documents are loaded and saved on DocConverter worker threads; bounds (needed for links) can only be
+//  calculated on the main thread since text measurement needs the nanovg context, so DocConverter::update()
+//  caches bounds of every page between loading and saving
 
 // main purpose is importing documents from original Android version of Write
 bool DocumentList::convertDocuments(FSPath src)
 {
-  int nFiles = 0, nErrors = 0, nDup = 0, nConvert = 0;
+  int nErrors = 0, nDup = 0, nConvert = 0;
   FSPath dest = src.parent().child(src.baseName() + "_converted/");
 
   auto confirm = ScribbleApp::messageBox(ScribbleApp::Info, _("Convert Documents"), fstring(
@@ -902,12 +1337,10 @@ bool DocumentList::convertDocuments(FSPath src)
   // make sure processEvents() doesn't stall
   ScribbleApp::gui->setTimer(100, dialog.get(), NULL, []() { return 100; });
 
-  ScribbleDoc* scribbleDoc = ScribbleApp::app->scribbleDocs[0];
   bool renameDups = !dest.exists();
   createPath(dest.path);
-  std::vector<std::string> allfiles = lsDirectory(src);
-  for(const std::string& file : allfiles) {
-    ++nFiles;
+  std::vector<FSPath> srcfiles;
+  for(const std::string& file : lsDirectory(src)) {
     if(file.empty() || file.front() == '.')
       continue;
     FSPath oldinfo = src.child(file);
@@ -915,86 +1348,61 @@ bool DocumentList::convertDocuments(FSPath src)
       continue;
     if(oldinfo.extension() == "svg" && StringRef(oldinfo.baseName()).chop(3).endsWith("_page"))
       continue;
+    srcfiles.push_back(oldinfo);
+  }
 
-    auto openres = scribbleDoc->openDocument(oldinfo.c_str(), true);
-
-    //FileStream* instrm = new FileStream(oldinfo.c_str(), "rb");
-    //std::unique_ptr<Document> newdoc(new Document());
-    //auto openres = newdoc->load(instrm, true);
-    if(openres == Document::LOAD_FATAL) {
-      ScribbleApp::messageBox(ScribbleApp::Error, _("Error"), fstring(_("Error loading file %s"), oldinfo.c_str()));
-      continue;
-    }
-    bool ok = (openres == Document::LOAD_OK || openres == Document::LOAD_EMPTYDOC);
-    //std::unique_ptr<ScribbleConfig> doccfg(new ScribbleConfig());
-    //doccfg->loadConfig(newdoc->getConfigNode());
-
-    ScribbleConfig* doccfg = scribbleDoc->cfg;
-    const char* oldtitle = doccfg->String("docTitle", "");
-    std::string title = (oldtitle[0] ? toValidFilename(oldtitle): oldinfo.baseName().c_str()) + ("." + docFileExt);
-    const char* tags = doccfg->String("docTags", "");
+  // documents are loaded and saved on worker threads; only naming is done here on main thread
+  DocConverter converter(ScribbleApp::cfg);
+  converter.saveThumbnail = ScribbleApp::cfg->Bool("saveThumbnail");
+  converter.getDest = [&](const DocConverter::Job& job) {
+    const char* oldtitle = job.cfg->String("docTitle", "");
+    std::string title = (oldtitle[0] ? toValidFilename(oldtitle): job.src.baseName().c_str()) + ("." + docFileExt);
+    const char* tags = job.cfg->String("docTags", "");
     FSPath newinfo = tags[0] ? dest.child(toValidFilename(tags)).child(title) : dest.child(title);
     if(!renameDups && newinfo.exists()) {
       ++nDup;
-      continue;
+      return FSPath();
     }
-    // renamed, baseRenamed
+    // reserve name by creating file, since earlier documents may not have been saved yet
     for(int ii = 2; newinfo.exists(); ii++)
       newinfo = newinfo.parent().child(fstring("%s (%d).%s", newinfo.baseName().c_str(), ii, newinfo.extension().c_str()));
     if(tags[0])
       createPath(newinfo.parent().path);
-
-
-    // rendering document on main thread in ScribbleArea while saving seems to cause problems
-    /*std::thread saveThread([&](){
-      // thumbnail requires ScribbleArea to draw and can only be drawn main thread (owner of GL context)
-      Image thumbnail = ScribbleDoc::extractThumbnail(oldinfo.c_str());
-      auto buff = Image::toBase64(thumbnail.encode());
-      FileStream* strm = new FileStream(newinfo.c_str(), "wb+");
-      Document::saveflags_t flags = Document::SAVE_FORCE;
-      flags |= doccfg->Int("compressLevel", 2) << 24;  // ignored for uncompressed formats
-      if(!strm->is_open() || !newdoc->save(strm, (char*)buff.data(), flags)) {
-        ok = false;
-        delete strm;
-      }
-
-      SDL_Event event = {0};
-      event.type = ScribbleApp::app->scribbleSDLEvent;
-      event.user.code = ScribbleApp::DISMISS_DIALOG;
-      event.user.data1 = (void*)-1;
-      SDL_PushEvent(&event);
-      PLATFORM_WakeEventLoop();
-    });*/
-
-    std::string fulltitle = fstring("%s%s%s", tags, tags[0] ? "/" : "", newinfo.baseName().c_str());
-    //std::string msgres = ScribbleApp::messageBox(ScribbleApp::Info,
-    //    fstring("Converting Documents: %d%%", 100*nFiles/allfiles.size()),
-    //    fstring("Converting %s", fulltitle.c_str()), "Cancel");
-
-    // show dialog
-    dialog->setTitle(fstring(_("Converting Documents: %d%%"), 100*nFiles/allfiles.size()).c_str());
-    msgText->setText(fstring(_("Converting %s"), fulltitle.c_str()).c_str());
+    FileStream reserved(newinfo.c_str(), "wb");
+    return newinfo;
+  };
+  converter.start(srcfiles);
+  while(converter.update()) {
+    // only aggregate progress is shown since many documents are in progress at once
+    int ndone = converter.numDone();
+    dialog->setTitle(fstring(_("Converting Documents: %d%%"), 100*ndone/converter.numJobs()).c_str());
+    msgText->setText(fstring(_("Converted %d of %d documents"), ndone, converter.numJobs()).c_str());
     dialog->setWinBounds(Rect::centerwh(dialog->winBounds().center(), 0, 0));
     Application::processEvents();
     Application::layoutAndDraw();
-    // save doc
-    ok = scribbleDoc->saveDocument(newinfo.c_str(), Document::SAVE_FORCE) && ok;
     // check for dialog close
-    Application::processEvents();
-    Application::layoutAndDraw();
-    if(!dialog->isVisible())
+    if(!dialog->isVisible()) {
+      converter.cancel();
       return false;
+    }
+  }
 
-    //saveThread.join();
-    //if(!msgres.empty())
-    //  return false;
-    if(!ok) {
-      ++nErrors;
-      ScribbleApp::messageBox(ScribbleApp::Error, _("Error"), fstring(
-          _("Errors occurred converting \"%s\" from file \"%s\" - please examine document after conversion finishes."),
-          fulltitle.c_str(), oldinfo.fileName().c_str()));
+  std::vector<std::string> failed;
+  for(const DocConverter::Job& job : converter.results()) {
+    if(job.status == DocConverter::CONVERTED)
+      ++nConvert;
+    if(job.status == DocConverter::LOAD_ERROR || job.status == DocConverter::SAVE_ERROR || job.loadErrors)
+      failed.push_back(job.src.fileName());
+  }
+  nErrors = failed.size();
+  if(!failed.empty()) {
+    if(failed.size() > 10) {
+      failed.resize(10);
+      failed.back() = "...";
     }
-    ++nConvert;
+    ScribbleApp::messageBox(ScribbleApp::Error, _("Error"), fstring(
+        _("Errors occurred converting the following files - please examine documents after conversion finishes: %s"),
+        joinStr(failed, ", ").c_str()));
   }
   dialog->finish(0);
   setCurrDir(dest.c_str());  // show user the output folder
@@ -6,6 +6,30 @@
 #include "basics.h"
 
 class ScribbleApp;
+class DocIndex;
+struct DocListTask;
+
+// document list entry; details are filled in on background thread
+struct DocListEntry
+{
+  FSPath fileinfo;
+  Timestamp mtime = -1;
+  long fsize = -1;  // number of items for folder
+  int numPages = 0;  // from DocIndex; 0 if unknown
+  SvgNode* thumbnail = NULL;  // owned by entry; attached to item's icon container while shown
+  bool thumbRequested = false;  // requested from (or already returned by) listing worker
+};
+
+// list item widget bound to a DocListEntry
+struct DocListItem
+{
+  Button* button = NULL;
+  SvgContainerNode* iconContainer = NULL;
+  TextBox* title = NULL;
+  TextBox* mtime = NULL;  // only for list mode
+  TextBox* fsize = NULL;
+  int entry = -1;
+};
 
 class NewDocDialog : public Dialog
 {
@@ -21,7 +45,7 @@ public:
 class DocumentList : public Window
 {
 public:
-  DocumentList(const char* root, const char* temp);
+  DocumentList(const char* root, const char* temp, const char* thumbcache = "", const char* indexfile = "");
   //~DocumentList() { MainWindow::removeDir(trashPath, true); }
 
   std::string selectedFile;  // filename out
@@ -93,6 +117,21 @@ private:
   bool docListSiloed = false;
   FSPath undoDeleteDir;
   FSPath trashPath;
+  FSPath thumbCacheDir;
+  std::shared_ptr<DocIndex> docIndex;  // shared with listing worker
+  TextEdit* searchEdit = NULL;
+  std::string searchQuery;
+  // background listing of currDir
+  std::shared_ptr<DocListTask> listTask;
+  Timer* listTimer = NULL;
+  // virtualized list: items are only created for entries near viewport and rebound as list is scrolled
+  std::vector<DocListEntry> listEntries;
+  std::vector<DocListItem> listItems;
+  SvgNode* topSpacer = NULL;
+  SvgNode* bottomSpacer = NULL;
+  Dim itemPitch = 0;
+  int boundFirst = -1, boundLast = -1;
+  int thumbFirst = 0, thumbLast = 0;  // entries which may have thumbnails loaded
 
   FSPath currDir;
   FSPath contextMenuItem;
@@ -101,6 +140,14 @@ private:
   Mode_t currMode = OPEN_DOC; //chooseOnly;
 
   void setCurrDir(const char* path);
+  bool updateListItems();
+  void updateVisibleItems(bool force = false);
+  void updateThumbnails();
+  DocListItem createItem();
+  void bindItem(DocListItem& item, int idx, bool force = false);
+  void unbindItem(DocListItem& item);
+  void clearListItems();
+  Rect iconSize() const;
   void createUI();
   bool convertDocuments(FSPath src);
   void zoomListView(int step);
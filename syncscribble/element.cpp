@@ -146,61 +146,123 @@ bool Element::setProperties(const StrokeProperties& props)
   return applyProperties(props, node);
 }
 
-static bool erasePenPoints(std::vector<PenPoint>& in, const std::vector<Point>& clip)
-{
-  //SCRIBBLE_LOG("\n\nStart erase\n");
-  //std::vector<PenPoint> in = subject;
-  std::vector<PenPoint> out;
-  // iterate over edges of clip polygon
-  for(size_t cp1 = clip.size() - 1, cp2 = 0; cp2 < clip.size(); cp1 = cp2++) {
-    out.reserve(in.size());
-    // iterate over edges of subject polygon
-    out.push_back(in[0]);
-    for(size_t ii = 1; ii < in.size(); ++ii) {
-      if(!in[ii].moveTo()) {
-        // would this make a difference: Rect::corners(cp1, cp2).intersects(Rect::corners(ii-1, ii))?
-        Point x = segmentIntersection(clip[cp1], clip[cp2], in[ii-1].p, in[ii].p);
-        if(!x.isNaN()) {
-          auto dir = cross(clip[cp2] - clip[cp1], in[ii].p - in[ii-1].p) > 0 ? PenPoint::Entering : PenPoint::Leaving;
-          Dim t = (x - in[ii-1].p).dist() / (in[ii].p - in[ii-1].p).dist();
-          Point dr = (t*in[ii].dr.dist() + (1-t)*in[ii-1].dr.dist()) * normal(in[ii].p - in[ii-1].p);
-          out.emplace_back(x, dr, (Path2D::LineTo | dir));
-        }
-      }
-      out.push_back(in[ii]);
-    }
-    out.swap(in);
-    out.clear();
+// eraser is a convex quad, so clipping a stroke against it is a single pass over the stroke's segments using
+//  the signed distance of each endpoint to each edge (Cyrus-Beck); segments outside the quad's bbox are skipped
+class EraserClip
+{
+public:
+  EraserClip(const Point& prevpos, const Point& pos, Dim radius, const Transform2D& tf);
+  bool contains(const Point& p) const;
+  bool clipSegment(const Point& a, const Point& b, Dim* t0out, Dim* t1out) const;
+
+private:
+  Dim edgeDist(int ii, const Point& p) const { return orient*cross(pts[ii+1 < 4 ? ii+1 : 0] - pts[ii], p - pts[ii]); }
+
+  Point pts[4];
+  Rect bbox;
+  Dim orient;  // so that edgeDist() is positive outside regardless of winding
+};
+
+// tf maps eraser from page coords to element's coords
+EraserClip::EraserClip(const Point& prevpos, const Point& pos, Dim radius, const Transform2D& tf)
+{
+  Point dr = pos == prevpos ? Point(1, 0) : (pos - prevpos).normalize();
+  Point n = normal(dr);
+  pts[0] = tf.map(prevpos + radius*(-dr + n));
+  pts[1] = tf.map(prevpos + radius*(-dr - n));
+  pts[2] = tf.map(pos + radius*(dr - n));
+  pts[3] = tf.map(pos + radius*(dr + n));
+  bbox = Rect::corners(pts[0], pts[2]);
+  bbox.rectUnion(Rect::corners(pts[1], pts[3]));
+  Dim area2 = 0;
+  for(int ii = 0; ii < 4; ++ii)
+    area2 += cross(pts[ii], pts[ii+1 < 4 ? ii+1 : 0]);
+  orient = area2 > 0 ? -1 : 1;
+}
+
+bool EraserClip::contains(const Point& p) const
+{
+  if(p.x < bbox.left || p.x > bbox.right || p.y < bbox.top || p.y > bbox.bottom)
+    return false;
+  for(int ii = 0; ii < 4; ++ii) {
+    if(edgeDist(ii, p) > 0)
+      return false;
   }
-  // no intersections doesn't mean not touched (e.g. subpath entirely inside erase path, possibly with other
-  //  subpaths entirely outside)
-  bool touched = false;
-  out.reserve(in.size());
-  for(size_t ii = 0; ii < in.size();) {
-    // determine initial state of erase by finding first intersection; if no intersection, erase iff all
-    //  points inside clip
-    bool erase = pointInPolygon(clip, in[ii].p);
-    for(size_t jj = ii+1; jj < in.size() && !in[jj].moveTo(); ++jj) {
-      if(in[jj].intersection()) {
-        erase = in[jj].intersection() == PenPoint::Leaving;
-        break;
-      }
-      erase = erase && pointInPolygon(clip, in[jj].p);
-    }
+  return true;
+}
 
-    do {
-      if(in[ii].intersection()) {
-        // inside -> outside: moveTo; outside -> inside: lineTo; note that we clear intersect flag
-        out.emplace_back(in[ii].p, in[ii].dr, erase ? Path2D::MoveTo : Path2D::LineTo);
-        erase = in[ii].intersection() == PenPoint::Entering;  //!erase;
+// returns false if segment a-b does not cross eraser; otherwise, part of segment from t0 to t1 is inside
+bool EraserClip::clipSegment(const Point& a, const Point& b, Dim* t0out, Dim* t1out) const
+{
+  if(std::max(a.x, b.x) < bbox.left || std::min(a.x, b.x) > bbox.right
+      || std::max(a.y, b.y) < bbox.top || std::min(a.y, b.y) > bbox.bottom)
+    return false;
+  Dim t0 = 0, t1 = 1;
+  for(int ii = 0; ii < 4; ++ii) {
+    Dim da = edgeDist(ii, a);
+    Dim db = edgeDist(ii, b);
+    if(da > 0 && db > 0)
+      return false;
+    if(da > 0)
+      t0 = std::max(t0, da/(da - db));
+    else if(db > 0)
+      t1 = std::min(t1, da/(da - db));
+  }
+  *t0out = t0;
+  *t1out = t1;
+  return t0 < t1;
+}
+
+// index of first point which is erased or which ends an erased segment; in.size() if eraser misses stroke
+static size_t firstErased(const std::vector<PenPoint>& in, const EraserClip& clip)
+{
+  Dim t0, t1;
+  for(size_t ii = 0; ii < in.size(); ++ii) {
+    if(clip.contains(in[ii].p))
+      return ii;
+    if(ii > 0 && !in[ii].moveTo() && clip.clipSegment(in[ii-1].p, in[ii].p, &t0, &t1))
+      return ii;
+  }
+  return in.size();
+}
+
+static PenPoint erasePoint(const PenPoint& a, const PenPoint& b, Dim t, unsigned int cmd)
+{
+  Point d = b.p - a.p;
+  Point dr = (t*b.dr.dist() + (1-t)*a.dr.dist()) * normal(d);
+  return PenPoint(a.p + t*d, dr, cmd);
+}
+
+// removes parts of stroke inside eraser, splitting stroke into subpaths as needed; out is scratch space supplied
+//  by caller so it can be reused (it ends up swapped with in)
+static bool erasePenPoints(std::vector<PenPoint>& in, const EraserClip& clip, std::vector<PenPoint>& out)
+{
+  size_t start = firstErased(in, clip);
+  if(start >= in.size())
+    return false;
+  out.clear();
+  out.reserve(in.size() + 8);
+  out.insert(out.end(), in.begin(), in.begin() + start);
+  bool erased = false;  // previous point was inside eraser
+  Dim t0, t1;
+  for(size_t ii = start; ii < in.size(); ++ii) {
+    const PenPoint& b = in[ii];
+    bool reopen = erased;
+    if(ii > 0 && !b.moveTo() && clip.clipSegment(in[ii-1].p, b.p, &t0, &t1)) {
+      // outside -> inside: end current subpath; inside -> outside: start new subpath
+      if(t0 > 0)
+        out.push_back(erasePoint(in[ii-1], b, t0, Path2D::LineTo));
+      if(t1 < 1) {
+        out.push_back(erasePoint(in[ii-1], b, t1, Path2D::MoveTo));
+        reopen = false;
       }
-      else if(!erase)
-        out.push_back(in[ii]);
-      touched = touched || erase;
-    } while(++ii < in.size() && !in[ii].moveTo());
+    }
+    erased = clip.contains(b.p);
+    if(!erased)
+      out.emplace_back(b.p, b.dr, reopen ? Path2D::MoveTo : b.cmd);
   }
   out.swap(in);
-  return touched;
+  return true;
 }
 
 // rebuild path from PenPoints
@@ -263,10 +325,10 @@ void Element::fromPenPoints(const std::vector<PenPoint>& pts)
 }
 
 // storing penPoints in Element might help avoid any numerical issues caused by repeated scaling operations
-std::vector<PenPoint> Element::toPenPoints()
+void Element::toPenPoints(std::vector<PenPoint>& pts) const
 {
   const Path2D& path = *static_cast<SvgPath*>(node)->path();
-  std::vector<PenPoint> pts;
+  pts.clear();
 
   if(node->hasClass(FLAT_PEN_CLASS) || node->hasClass("write-fstroke")) {
     pts.reserve(path.size()/2);
@@ -316,35 +378,164 @@ std::vector<PenPoint> Element::toPenPoints()
     for(int ii = 0; ii < path.size(); ++ii)
       pts.emplace_back(path.point(ii), Point(0,0), path.command(ii)); // == PainterPath::MoveTo);
   }
-  return pts;
+}
+
+// Free eraser for images: pixel centers in each row lie on a line, which crosses the eraser capsule (union of
+//  end caps and the rectangle between them) in a single interval, so we can clear whole spans of pixels at once
+class ImageEraser
+{
+public:
+  ImageEraser(SvgImage* imagenode, const Point& prevpos, const Point& pos, Dim radius);
+  bool rowSpan(int y, int* xaout, int* xbout) const;
+
+  int y0, y1;
+
+private:
+  static bool clipLinear(Dim c, Dim k, Dim lo, Dim hi, Dim* x0, Dim* x1);
+  bool capSpan(const Point& a, const Point& c, Dim* x0, Dim* x1) const;
+
+  Transform2D tf;  // maps pixels to page
+  Point u;  // page space step between pixels in a row
+  Point p0, p1;
+  Dim radius;
+  int width;
+};
+
+ImageEraser::ImageEraser(SvgImage* imagenode, const Point& prevpos, const Point& pos, Dim _radius)
+    : p0(prevpos), p1(pos), radius(_radius)
+{
+  Image* image = imagenode->image();
+  Rect bounds = imagenode->viewport(); //bounds();
+  width = image->width;
+  Dim sx = bounds.width()/image->width;
+  Dim sy = bounds.height()/image->height;
+  tf = imagenode->getTransform() * Transform2D(sx, 0, 0, sy, bounds.left, bounds.top);
+  u = tf.map(Point(1, 0)) - tf.map(Point(0, 0));
+  // translate eraser bbox to pixel rows
+  const Rect r = tf.inverse().mapRect(Rect::corners(prevpos, pos).pad(radius));
+  y0 = std::max(int(r.top + 0.5), 0);
+  y1 = std::min(int(r.bottom + 0.5), image->height - 1);
+}
+
+// restrict [x0, x1] to values of x for which lo <= c + k*x <= hi
+bool ImageEraser::clipLinear(Dim c, Dim k, Dim lo, Dim hi, Dim* x0, Dim* x1)
+{
+  if(k == 0)
+    return c >= lo && c <= hi;
+  Dim xa = (lo - c)/k, xb = (hi - c)/k;
+  if(k < 0)
+    std::swap(xa, xb);
+  *x0 = std::max(*x0, xa);
+  *x1 = std::min(*x1, xb);
+  return *x0 < *x1;
+}
+
+// interval of x for which a + x*u is inside circle of radius about c
+bool ImageEraser::capSpan(const Point& a, const Point& c, Dim* x0, Dim* x1) const
+{
+  Point w = a - c;
+  Dim uu = u.x*u.x + u.y*u.y;
+  Dim uw = u.x*w.x + u.y*w.y;
+  Dim disc = uw*uw - uu*(w.x*w.x + w.y*w.y - radius*radius);
+  if(uu <= 0 || disc <= 0)
+    return false;
+  Dim sq = std::sqrt(disc);
+  *x0 = (-uw - sq)/uu;
+  *x1 = (-uw + sq)/uu;
+  return true;
+}
+
+// pixels xa to xb (inclusive) of row y have centers within radius of segment p0 - p1
+bool ImageEraser::rowSpan(int y, int* xaout, int* xbout) const
+{
+  Point a = tf.map(Point(0.5, y + 0.5));  // center of first pixel in row
+  Dim xmin = MAX_DIM, xmax = -MAX_DIM;
+  Dim x0, x1;
+  if(capSpan(a, p0, &x0, &x1)) { xmin = std::min(xmin, x0);  xmax = std::max(xmax, x1); }
+  if(capSpan(a, p1, &x0, &x1)) { xmin = std::min(xmin, x0);  xmax = std::max(xmax, x1); }
+  Point e = p1 - p0;
+  if(e.x != 0 || e.y != 0) {
+    Point n = normal(e);
+    Point w = a - p0;
+    x0 = -MAX_DIM;  x1 = MAX_DIM;
+    if(clipLinear(n.x*w.x + n.y*w.y, n.x*u.x + n.y*u.y, -radius, radius, &x0, &x1)
+        && clipLinear(e.x*w.x + e.y*w.y, e.x*u.x + e.y*u.y, 0, e.x*e.x + e.y*e.y, &x0, &x1)) {
+      xmin = std::min(xmin, x0);
+      xmax = std::max(xmax, x1);
+    }
+  }
+  if(xmin >= xmax)
+    return false;
+  // pixel centers strictly inside (xmin, xmax)
+  *xaout = int(std::max(Dim(0), std::floor(xmin) + 1));
+  *xbout = int(std::min(Dim(width - 1), std::ceil(xmax) - 1));
+  return *xaout <= *xbout;
+}
+
+// only clear alpha ... clearing RGB too (to black) gives ugly border due to GL_LINEAR interpolation; simple loop
+//  w/o early exit so compiler can vectorize; returns true if any pixel was not already transparent
+static bool clearAlpha(unsigned int* pixels, int n)
+{
+  unsigned int alpha = 0;
+  for(int ii = 0; ii < n; ++ii) {
+    alpha |= pixels[ii];
+    pixels[ii] &= ~Color::A;
+  }
+  return (alpha & Color::A) != 0;
+}
+
+// returns true if freeErase() would modify this element; lets caller avoid cloning elements eraser misses
+bool Element::freeEraseTest(const Point& prevpos, const Point& pos, Dim radius, std::vector<PenPoint>& scratch) const
+{
+  if(isMultiStroke()) {
+    for(Element* s : children()) {
+      if(s->freeEraseTest(prevpos, pos, radius, scratch))
+        return true;
+    }
+  }
+  else if(isPathElement()) {
+    EraserClip clip(prevpos, pos, radius, node->getTransform().inverse());
+    if(!penPoints.empty())
+      return firstErased(penPoints, clip) < penPoints.size();
+    toPenPoints(scratch);
+    return firstErased(scratch, clip) < scratch.size();
+  }
+  else if(node->type() == SvgNode::IMAGE) {
+    SvgImage* imagenode = static_cast<SvgImage*>(node);
+    if(!ERASE_IMAGES || !imagenode->m_linkStr.empty())
+      return false;
+    // don't clone image if eraser only passes over transparent pixels
+    ImageEraser eraser(imagenode, prevpos, pos, radius);
+    const unsigned int* pixels = imagenode->image()->pixels();
+    int xa, xb;
+    for(int y = eraser.y0; y <= eraser.y1; ++y) {
+      if(!eraser.rowSpan(y, &xa, &xb))
+        continue;
+      const unsigned int* row = pixels + y*imagenode->image()->width;
+      for(int x = xa; x <= xb; ++x) {
+        if(row[x] & Color::A)
+          return true;
+      }
+    }
+  }
+  return false;
 }
 
 // we assume caller has already detemined that our bbox intersects eraser bbox
-bool Element::freeErase(const Point& prevpos, const Point& pos, Dim radius)
+bool Element::freeErase(const Point& prevpos, const Point& pos, Dim radius, std::vector<PenPoint>& scratch)
 {
   bool touched = false;
 
   if(isMultiStroke()) {
     for(Element* s : children())
-      touched = s->freeErase(prevpos, pos, radius) || touched;
+      touched = s->freeErase(prevpos, pos, radius, scratch) || touched;
   }
   else if(isPathElement()) {
-    Path2D eraser;
-    Point dr = pos == prevpos ? Point(1, 0) : (pos - prevpos).normalize();
-    Point n = normal(dr);
-    eraser.moveTo(prevpos + radius*(-dr + n));
-    eraser.lineTo(prevpos + radius*(-dr - n));
-    eraser.lineTo(pos + radius*(dr - n));
-    eraser.lineTo(pos + radius*(dr + n));
-    eraser.closeSubpath();
-    eraser.transform(node->getTransform().inverse());
-    if(polygonArea(eraser.points) > 0)
-      std::reverse(eraser.points.begin(), eraser.points.end());
-
+    EraserClip clip(prevpos, pos, radius, node->getTransform().inverse());
     if(penPoints.empty())
-      penPoints = toPenPoints();
+      toPenPoints(penPoints);
     if(!penPoints.empty())
-      touched = erasePenPoints(penPoints, eraser.points);
+      touched = erasePenPoints(penPoints, clip, scratch);
     if(touched) {
       fromPenPoints(penPoints);
       // for wide stroke, dirty area may be larger than eraser bbox, so we just have to dirty whole stroke
@@ -367,30 +558,15 @@ bool Element::freeErase(const Point& prevpos, const Point& pos, Dim radius)
     //painter.endFrame();
 
     Image* image = imagenode->image();
-    Rect bounds = imagenode->viewport(); //bounds();
     unsigned int* pixels = image->pixels();
-
-    const int hpixels = image->width;
-    const int vpixels = image->height;
-    const Dim sx = bounds.width()/hpixels;
-    const Dim sy = bounds.height()/vpixels;
-
-    Transform2D tf = node->getTransform() * Transform2D(sx, 0, 0, sy, bounds.left, bounds.top);
-
-    const Dim radius2 = radius*radius;
-    // translate pos to a pixel position
-    const Rect r = tf.inverse().mapRect(Rect::corners(prevpos, pos).pad(radius));
-    const int x0 = std::max(int(r.left + 0.5), 0);
-    const int x1 = std::min(int(r.right + 0.5), hpixels-1);
-    const int y0 = std::max(int(r.top + 0.5), 0);
-    const int y1 = std::min(int(r.bottom + 0.5), vpixels-1);
-    for(int y = y0; y <= y1; y++) {
-      for(int x = x0; x <= x1; x++)
-        // only clear alpha ... clearing RGB too (to black) gives ugly border due to GL_LINEAR interpolation
-        if(distToSegment2(prevpos, pos, tf.map(Point(x + 0.5, y + 0.5))) < radius2)  //Point((x + 0.5)/sx + bounds.left, (y + 0.5)/sy + bounds.top)) < radius2)
-          pixels[y*hpixels + x] &= ~Color::A;
+    ImageEraser eraser(imagenode, prevpos, pos, radius);
+    int xa, xb;
+    for(int y = eraser.y0; y <= eraser.y1; ++y) {
+      if(eraser.rowSpan(y, &xa, &xb))
+        touched = clearAlpha(pixels + y*image->width + xa, xb - xa + 1) || touched;
     }
-    touched = true;
+    if(!touched)
+      return false;
 
     // we assume caller will set dirty rect, so we don't have to redraw whole image
     //node->setDirty(SvgNode::PIXELS_DIRTY);
@@ -498,7 +674,7 @@ void Element::scaleWidth(Dim sx_int, Dim sy_int)
 
   // this will be a no-op except for known Write path types
   if(penPoints.empty())
-    penPoints = toPenPoints();
+    toPenPoints(penPoints);
   for(PenPoint& p : penPoints) {
     p.dr.x *= sx_int;
     p.dr.y *= sy_int;
@@ -547,7 +723,7 @@ void Element::applyTransform(const ScribbleTransform& tf)
     Transform2D pttf = node->getTransform().inverse() * tf.tf() * node->getTransform();
     if(node->hasClass(FLAT_PEN_CLASS) || node->hasClass(ROUND_PEN_CLASS) || node->hasClass(CHISEL_PEN_CLASS)) {
       if(penPoints.empty())
-        penPoints = toPenPoints();
+        toPenPoints(penPoints);
       for(PenPoint& p : penPoints) {
         p.p = pttf.map(p.p);
         if(tf.yscale() < 0)  // note x flipped for y scale < 0 (and y for x scale < 0)
@@ -128,14 +128,12 @@ typedef SvgExtIter<Element*> ElementIter;
 struct PenPoint
 {
   using PathCommand = Path2D::PathCommand;
-  enum Direction { Entering = 0x1000, Leaving = 0x2000 };
   Point p;
   Point dr;
   unsigned int cmd;
 
   PenPoint(const Point& _p, const Point& _dr, unsigned int _cmd) : p(_p), dr(_dr), cmd(_cmd) {}
   bool moveTo() const { return (cmd & 0xFF) == PathCommand::MoveTo; }
-  Direction intersection() const { return Direction(cmd & (Entering | Leaving)); }
 };
 
 class Element : public SvgNodeExtension
@@ -182,7 +180,9 @@ public:
   void setNodeId(const char* id) { node->setXmlId(id); }
   const char* nodeId() const { return node->xmlId(); }
 
-  bool freeErase(const Point& prevpos, const Point& pos, Dim radius);
+  // scratch is working space, reused between calls to avoid allocation
+  bool freeErase(const Point& prevpos, const Point& pos, Dim radius, std::vector<PenPoint>& scratch);
+  bool freeEraseTest(const Point& prevpos, const Point& pos, Dim radius, std::vector<PenPoint>& scratch) const;
   std::vector<Element*> getEraseSubPaths();
 
   void updateFromNode();
@@ -205,7 +205,7 @@ protected:
   ~Element() override {}
 
 private:
-  std::vector<PenPoint> toPenPoints();
+  void toPenPoints(std::vector<PenPoint>& pts) const;
   void fromPenPoints(const std::vector<PenPoint>& pts);
 
   const Selection* m_selection;
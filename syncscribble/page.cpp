@@ -6,6 +6,8 @@
 
 
 Dim Page::BLANK_Y_RULING = 40;
+Dim ElementGrid::cellSize = 64;
+int ElementGrid::maxCells = 64;
 bool Page::enableDropShadow = true;
 
 // for legacy support (esp. ScribbleTest); note that we force paper to be opaque
@@ -66,16 +68,6 @@ bool Page::setProperties(const PageProperties* newprops)
   return (r.right > props.width && r.right < oldwidth) || (r.bottom > props.height && r.bottom < oldheight);
 }
 
-int Page::getPageNum() const
-{
-  // lookup page number; this should be made a method of Document
-  for(unsigned int pp = 0; pp < document->pages.size(); pp++) {
-    if(document->pages[pp] == this)
-      return pp;
-  }
-  return -1;  // should never happen
-}
-
 int Page::getLine(Dim y) const
 {
   return (int)floor((y - yRuleOffset)/yruling(true));
@@ -207,7 +199,7 @@ void Page::generateRuleLayer(Color pageColor, Dim w, Dim h)
 void Page::draw(Painter* painter, const Rect& dirty, bool rulelines)
 {
   // draw red border around page if it failed to load
-  ensureLoaded(false);  // skip memory check in case it is slow on some platforms
+  ensureLoaded();
   if(loadStatus != LOAD_OK)
     painter->fillRect(Rect::ltrb(-10, -10, width()+10, height()+10), Color::RED);
   // draw drop shadow
@@ -240,11 +232,228 @@ void Page::draw(Painter* painter, const Rect& dirty, bool rulelines)
     painter->fillRect(rect(), Color(props.color.luma() > 127 ? Color::BLUE : Color::YELLOW).setAlphaF(0.4f));
 }
 
-bool Page::saveSVG(IOStream& file, Dim x, Dim y)
+// Compact path encoding: optionally (binpaths = true for saveSVG()) path data is also written to a __bpts
+//  attribute: delta and zigzag varint encoded coordinates with run-length encoded commands, base64 encoded.
+//  Encoding is lossless: coordinates are stored as integer multiples of 10^-k for the smallest k (up to
+//  PATH_BIN_MAX_EXP) that reproduces every coordinate of the path exactly - true for any path loaded from
+//  SVG text - otherwise as the bits of each double.  d is reduced to the first point, so the file remains
+//  valid SVG.  Attribute is decoded and removed on load, so in-memory model is the same for either encoding.
+// Version 1 (points quantized to 1/1024) is still read
+static constexpr int PATH_BIN_MAX_EXP = 6;
+static constexpr uint8_t PATH_BIN_RAW = 0xFF;  // in place of exponent for raw doubles
+static constexpr Dim PATH_BIN_MAX = 1E6;  // larger coordinates would lose precision when scaled
+static constexpr uint8_t PATH_BIN_VERSION = 2;
+static const Dim pathBinScales[] = {1, 10, 100, 1000, 1E4, 1E5, 1E6};
+
+static void putVarint(std::vector<unsigned char>& out, uint64_t x)
+{
+  while(x >= 0x80) {
+    out.push_back(uint8_t(x) | 0x80);
+    x >>= 7;
+  }
+  out.push_back(uint8_t(x));
+}
+
+static bool getVarint(const unsigned char*& p, const unsigned char* end, uint64_t* xout)
+{
+  uint64_t x = 0;
+  for(int shift = 0; p < end && shift < 64; shift += 7) {
+    uint8_t b = *p++;
+    x |= uint64_t(b & 0x7F) << shift;
+    if(!(b & 0x80)) {
+      *xout = x;
+      return true;
+    }
+  }
+  return false;
+}
+
+static uint64_t zigzag(int64_t x) { return (uint64_t(x) << 1) ^ uint64_t(x >> 63); }
+static int64_t unzigzag(uint64_t x) { return int64_t(x >> 1) ^ -int64_t(x & 1); }
+
+static uint64_t dimBits(Dim x) { uint64_t b;  memcpy(&b, &x, sizeof(b));  return b; }
+static Dim bitsDim(uint64_t b) { Dim x;  memcpy(&x, &b, sizeof(x));  return x; }
+
+// smallest exponent k for which every coordinate is exactly an integer / 10^k, or -1 if none
+static int pathBinExp(const Path2D& path)
+{
+  for(int k = 0; k <= PATH_BIN_MAX_EXP; ++k) {
+    Dim scale = pathBinScales[k];
+    int ii = 0;
+    for(; ii < path.size(); ++ii) {
+      Point p = path.point(ii);
+      if(!(std::abs(p.x) < PATH_BIN_MAX && std::abs(p.y) < PATH_BIN_MAX))
+        return -1;
+      if(Dim(std::llround(p.x*scale))/scale != p.x || Dim(std::llround(p.y*scale))/scale != p.y)
+        break;
+    }
+    if(ii == path.size())
+      return k;
+  }
+  return -1;
+}
+
+static std::vector<unsigned char> encodePath(const Path2D& path)
+{
+  std::vector<unsigned char> out;
+  out.reserve(16 + 4*path.size());
+  out.push_back(PATH_BIN_VERSION);
+  int k = pathBinExp(path);
+  out.push_back(k < 0 ? PATH_BIN_RAW : uint8_t(k));
+  putVarint(out, path.size());
+  for(int ii = 0; ii < path.size();) {
+    int cmd = path.command(ii);
+    int jj = ii + 1;
+    while(jj < path.size() && path.command(jj) == cmd) ++jj;
+    out.push_back(uint8_t(cmd));
+    putVarint(out, jj - ii);
+    ii = jj;
+  }
+  // raw bits are differenced as unsigned, so wrap around is harmless
+  uint64_t x0 = 0, y0 = 0;
+  for(int ii = 0; ii < path.size(); ++ii) {
+    Point p = path.point(ii);
+    uint64_t x = k < 0 ? dimBits(p.x) : uint64_t(std::llround(p.x*pathBinScales[k]));
+    uint64_t y = k < 0 ? dimBits(p.y) : uint64_t(std::llround(p.y*pathBinScales[k]));
+    putVarint(out, zigzag(int64_t(x - x0)));
+    putVarint(out, zigzag(int64_t(y - y0)));
+    x0 = x;
+    y0 = y;
+  }
+  return out;
+}
+
+static bool decodePath(const char* b64, Path2D* pathout)
+{
+  auto data = base64_decode(b64, strlen(b64));
+  const unsigned char* p = (const unsigned char*)data.data();
+  const unsigned char* end = p + data.size();
+  if(p == end)
+    return false;
+  uint8_t version = *p++;
+  if(version != 1 && version != PATH_BIN_VERSION)
+    return false;
+  uint8_t k = 0;
+  if(version == PATH_BIN_VERSION && (p == end || ((k = *p++) > PATH_BIN_MAX_EXP && k != PATH_BIN_RAW)))
+    return false;
+  uint64_t n = 0;
+  if(!getVarint(p, end, &n) || n > uint64_t(end - p))
+    return false;
+  std::vector<uint8_t> cmds;
+  cmds.reserve(n);
+  while(cmds.size() < n) {
+    uint64_t run = 0;
+    if(p == end)
+      return false;
+    uint8_t cmd = *p++;
+    if(!getVarint(p, end, &run) || run == 0 || run > n - cmds.size())
+      return false;
+    cmds.insert(cmds.end(), run, cmd);
+  }
+  Path2D path;
+  path.reserve(n);
+  uint64_t x = 0, y = 0;
+  for(uint64_t ii = 0; ii < n; ++ii) {
+    uint64_t dx, dy;
+    if(!getVarint(p, end, &dx) || !getVarint(p, end, &dy))
+      return false;
+    x += uint64_t(unzigzag(dx));
+    y += uint64_t(unzigzag(dy));
+    Point pt;
+    if(version == 1)  // quantized to 1/1024
+      pt = Point(int32_t(x)/Dim(1024), int32_t(y)/Dim(1024));
+    else if(k == PATH_BIN_RAW)
+      pt = Point(bitsDim(x), bitsDim(y));
+    else
+      pt = Point(Dim(int64_t(x))/pathBinScales[k], Dim(int64_t(y))/pathBinScales[k]);
+    path.addPoint(pt, Path2D::PathCommand(cmds[ii]));
+  }
+  *pathout = std::move(path);
+  return true;
+}
+
+// collect path nodes in the order SvgWriter writes them as <path> elements; NULL for paths not to be encoded
+//  (ruling is always written as text)
+static void collectPaths(SvgNode* node, bool encode, const SvgNode* content, const SvgNode* rule,
+    std::vector<SvgPath*>& paths)
+{
+  encode = (encode || node == content) && node != rule;
+  if(node->type() == SvgNode::PATH && static_cast<SvgPath*>(node)->pathType() == SvgNode::PATH) {
+    SvgPath* pathnode = static_cast<SvgPath*>(node);
+    paths.push_back(encode && pathnode->path()->size() >= 2 ? pathnode : NULL);
+  }
+  else if(node->asContainerNode()) {
+    for(SvgNode* child : node->asContainerNode()->children())
+      collectPaths(child, encode, content, rule, paths);
+  }
+}
+
+static const char* findPathTag(const char* s, const char* end)
+{
+  static const char tag[] = "<path";
+  for(s = std::search(s, end, tag, tag + 5); s + 5 < end; s = std::search(s + 5, end, tag, tag + 5)) {
+    if(isspace(s[5]) || s[5] == '/' || s[5] == '>')
+      return s;
+  }
+  return end;
+}
+
+// write serialized SVG to out, replacing d of each encodable path with first point and __bpts; the page is not
+//  modified since this may run on a worker thread.  SVG is written unchanged if <path> elements can't be
+//  matched to paths
+static void writeBinPaths(const char* svg, size_t len, const std::vector<SvgPath*>& paths, IOStream& out)
+{
+  const char* end = svg + len;
+  size_t npaths = 0;
+  for(const char* s = findPathTag(svg, end); s < end; s = findPathTag(s + 5, end))
+    ++npaths;
+  if(npaths != paths.size()) {
+    out.write(svg, len);
+    return;
+  }
+  const char* written = svg;
+  size_t ii = 0;
+  for(const char* s = findPathTag(svg, end); s < end; s = findPathTag(s + 5, end), ++ii) {
+    SvgPath* pathnode = paths[ii];
+    if(!pathnode)
+      continue;
+    const char* tagend = std::find(s, end, '>');
+    const char* d = std::search(s, tagend, " d=\"", " d=\"" + 4);
+    const char* dend = d < tagend ? std::find(d + 4, tagend, '"') : tagend;
+    if(dend >= tagend)
+      continue;
+    const Path2D& path = *pathnode->path();
+    auto b64 = base64_encode(encodePath(path));
+    std::string attrs = fstring(" d=\"M%.12g %.12g\" __bpts=\"", path.point(0).x, path.point(0).y);
+    out.write(written, d - written);
+    out.write(attrs.data(), attrs.size());
+    out.write((const char*)b64.data(), strlen((const char*)b64.data()));
+    written = dend;  // closing quote
+  }
+  out.write(written, end - written);
+}
+
+static void decodePaths(SvgNode* node)
+{
+  if(node->type() == SvgNode::PATH) {
+    const char* b64 = node->getStringAttr("__bpts", NULL);
+    // if decoding fails, keep attribute so data isn't lost on next save
+    if(b64 && decodePath(b64, static_cast<SvgPath*>(node)->path()))
+      node->removeAttr("__bpts");
+    else if(b64)
+      PLATFORM_LOG("Error decoding compact path data\n");
+  }
+  else if(node->asContainerNode()) {
+    for(SvgNode* child : node->asContainerNode()->children())
+      decodePaths(child);
+  }
+}
+
+bool Page::saveSVG(IOStream& file, Dim x, Dim y, bool binpaths)
 {
   // ensure that page is actually loaded ... not a big deal if we fail since we're not
-  //   overwriting the original
-  if(!ensureLoaded())
+  //   overwriting the original; skip memory check since we may be on a worker thread (Document::saveBgz)
+  if(!ensureLoaded(false))
     return false;
 
   // write-v3 class is only set in output SVG, not internally, to enable browser-only CSS
@@ -261,10 +470,12 @@ bool Page::saveSVG(IOStream& file, Dim x, Dim y)
     svgDoc->setAttr("x", x);
     svgDoc->setAttr("y", y);
   }
+  std::vector<SvgPath*> paths;
+  if(binpaths)
+    collectPaths(svgDoc.get(), false, contentNode, ruleNode, paths);
   // write SVG
   XmlStreamWriter xmlwriter;
   SvgWriter(xmlwriter).serialize(svgDoc.get());
-  xmlwriter.save(file);
   svgDoc->removeAttr("x");
   svgDoc->removeAttr("y");
   contentNode->removeClass("write-v3");
@@ -273,6 +484,13 @@ bool Page::saveSVG(IOStream& file, Dim x, Dim y)
     contentNode->removeChild(ruleNode);
     svgDoc->addChild(ruleNode, contentNode);
   }
+  if(!binpaths) {
+    xmlwriter.save(file);
+    return true;
+  }
+  MemStream svgstrm;
+  xmlwriter.save(svgstrm);
+  writeBinPaths((const char*)svgstrm.data(), svgstrm.size(), paths, file);
   return true;
 }
 
@@ -386,6 +604,8 @@ void Page::contentToRuling()
     delete ruleNode;
   }
   ruleNode = contentNode;
+  strokeGrid.reset();
+  strokeOrder.clear();
   ruleNode->removeClass("write-content");
   ruleNode->addClass("ruleline");
   isCustomRuling = true;
@@ -467,11 +687,18 @@ bool Page::loadSVG(SvgDocument* doc)
       }
     }
 
+    // restore any paths saved with compact encoding
+    decodePaths(contentNode);
     // create elements for each stroke and find bookmarks - assuming implicit creation is disabled
     for(SvgNode* node : contentNode->children())
       onAddStroke(new Element(node));
   }
+  return finishLoad();
+}
 
+// set page properties from loaded SVG and generate ruling
+bool Page::finishLoad()
+{
   if(svgDoc->width().isPercent() || svgDoc->height().isPercent()) {
     Rect r = svgDoc->bounds();  // w/ width or height as % (and no canvasRect) this will be content bounds
     if(r.isValid()) {
@@ -502,10 +729,363 @@ bool Page::loadSVG(SvgDocument* doc)
 
   // load content
   onPageSizeChange();
+  strokeGrid.reset();
+  strokeOrder.clear();
   loadStatus = props.width > 0 && props.height > 0 ? LOAD_OK : LOAD_SVG_ERROR;
+  if(loadStatus == LOAD_OK && document) {
+    if(pageNum >= 0)
+      document->docPages[svgDoc.get()] = pageNum;
+    if(!namedNodesIndexed)
+      document->indexNamedNodes(this);
+  }
   return loadStatus == LOAD_OK;
 }
 
+// Single pass loader for pages written by saveSVG(): SVG text is tokenized directly into path nodes and
+//  Elements, with no intermediate DOM pass; only the restricted subset of SVG written by Write is accepted
+//  (content group of plain <path>s and optional std ruling group) - anything else (images, links, custom
+//  ruling, transforms, entities, legacy pages) is left to SvgParser and loadSVG()
+
+static bool isXmlSpace(char c) { return c == ' ' || c == '\n' || c == '\t' || c == '\r'; }
+
+class WritePageReader
+{
+public:
+  std::string name, value;  // current attribute
+  bool selfClosing = false;  // set when end of start tag is reached
+  bool ok = true;
+
+  WritePageReader(const char* buff, size_t len) : p(buff), end(buff + len) {}
+
+  void skipSpace() { while(p < end && isXmlSpace(*p)) ++p; }
+  bool atEnd() { skipSpace(); return p == end; }
+
+  bool accept(const char* s)
+  {
+    skipSpace();
+    size_t n = strlen(s);
+    if(size_t(end - p) < n || memcmp(p, s, n) != 0)
+      return false;
+    p += n;
+    return true;
+  }
+
+  void skipPast(const char* s)
+  {
+    size_t n = strlen(s);
+    while(size_t(end - p) >= n && memcmp(p, s, n) != 0) ++p;
+    p = size_t(end - p) >= n ? p + n : end;
+  }
+
+  // XML declaration, comments, doctype
+  void skipProlog()
+  {
+    for(;;) {
+      if(accept("<?")) skipPast("?>");
+      else if(accept("<!--")) skipPast("-->");
+      else if(accept("<!")) skipPast(">");
+      else return;
+    }
+  }
+
+  bool openTag(const char* tag)
+  {
+    const char* p0 = p;
+    if(accept("<") && accept(tag) && p < end && (isXmlSpace(*p) || *p == '>' || *p == '/'))
+      return true;
+    p = p0;
+    return false;
+  }
+
+  bool closeTag(const char* tag)
+  {
+    const char* p0 = p;
+    if(accept("</") && accept(tag) && accept(">"))
+      return true;
+    p = p0;
+    return false;
+  }
+
+  // read next attribute of current start tag; returns false at end of tag or on error (ok cleared)
+  bool nextAttr()
+  {
+    skipSpace();
+    if(p < end && *p == '>') {
+      ++p;
+      selfClosing = false;
+      return false;
+    }
+    if(accept("/>")) {
+      selfClosing = true;
+      return false;
+    }
+    const char* n0 = p;
+    while(p < end && *p != '=' && *p != '>' && *p != '/' && !isXmlSpace(*p)) ++p;
+    name.assign(n0, p);
+    if(name.empty() || !accept("="))
+      return fail();
+    skipSpace();
+    if(p == end || (*p != '"' && *p != '\''))
+      return fail();
+    char quote = *p++;
+    const char* v0 = p;
+    while(p < end && *p != quote && *p != '&' && *p != '<') ++p;
+    if(p == end || *p != quote)
+      return fail();  // entity references are left to full parser
+    value.assign(v0, p++);
+    return true;
+  }
+
+  // skip content of current element, including any nested elements with the same tag
+  bool skipElement(const char* tag)
+  {
+    std::string close = std::string("</") + tag;
+    int depth = 1;
+    while(depth > 0) {
+      while(p < end && *p != '<') ++p;
+      if(p == end)
+        return fail();
+      if(accept("<!--"))
+        skipPast("-->");
+      else if(accept(close.c_str()))
+        --depth;
+      else if(openTag(tag)) {
+        while(nextAttr()) {}
+        if(!selfClosing)
+          ++depth;
+      }
+      else
+        ++p;
+      if(!ok)
+        return false;
+    }
+    return accept(">");
+  }
+
+private:
+  bool fail() { ok = false;  p = end;  return false; }
+
+  const char* p;
+  const char* end;
+};
+
+// number parsing is shared with SvgParser (parseNumbersList) so geometry matches the full parser exactly
+static bool isPathCmd(char c) { return isalpha(c) && c != 'e' && c != 'E'; }
+
+// path data with only moveto, lineto, cubic and closepath commands (everything written for strokes)
+static bool parseWritePathData(const char* d, Path2D* path)
+{
+  std::vector<Dim> args;
+  Point pen(0, 0), start(0, 0);
+  while(isXmlSpace(*d)) ++d;
+  while(*d) {
+    char cmd = *d++;
+    const char* d0 = d;
+    while(*d && !isPathCmd(*d)) ++d;
+    StringRef argstr(d0, d - d0);
+    args.clear();
+    parseNumbersList(argstr, args);
+    bool rel = cmd >= 'a';
+    size_t nargs = (cmd == 'C' || cmd == 'c') ? 6 : (cmd == 'Z' || cmd == 'z') ? 0 : 2;
+    if(nargs == 0 ? !args.empty() : (args.empty() || args.size() % nargs != 0))
+      return false;
+    if(nargs == 0) {
+      path->closeSubpath();
+      pen = start;
+      continue;
+    }
+    for(size_t ii = 0; ii < args.size(); ii += nargs) {
+      const Dim* c = &args[ii];
+      Point r = rel ? pen : Point(0, 0);
+      switch(cmd) {
+      case 'M': case 'm':
+        pen = r + Point(c[0], c[1]);
+        // subsequent coordinate pairs are implicit lineto
+        if(ii == 0) {
+          start = pen;
+          path->moveTo(pen);
+        }
+        else
+          path->lineTo(pen);
+        break;
+      case 'L': case 'l':
+        pen = r + Point(c[0], c[1]);
+        path->lineTo(pen);
+        break;
+      case 'C': case 'c':
+        path->cubicTo(r.x + c[0], r.y + c[1], r.x + c[2], r.y + c[3], r.x + c[4], r.y + c[5]);
+        pen = r + Point(c[4], c[5]);
+        break;
+      default:
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+static bool parseSvgPx(const std::string& s, Dim* out)
+{
+  size_t n = s.size() > 2 && s.compare(s.size() - 2, 2, "px") == 0 ? s.size() - 2 : s.size();
+  std::vector<Dim> v;
+  StringRef str(s.data(), n);
+  parseNumbersList(str, v);
+  if(v.size() != 1)
+    return false;
+  *out = v[0];
+  return true;
+}
+
+static void addClasses(SvgNode* node, const char* s)
+{
+  std::string cls;
+  for(const char* p = s; ; ++p) {
+    if(!*p || isXmlSpace(*p)) {
+      if(!cls.empty() && !node->hasClass(cls.c_str()))
+        node->addClass(cls.c_str());
+      cls.clear();
+      if(!*p)
+        return;
+    }
+    else
+      cls.push_back(*p);
+  }
+}
+
+// returns new stroke with Element or NULL if attributes or path data are not supported
+static SvgPath* readWritePath(WritePageReader& rd)
+{
+  std::unique_ptr<SvgPath> node(new SvgPath());
+  std::string bpts;
+  Timestamp ts = 0;
+  Point com(NaN, NaN);
+  while(rd.nextAttr()) {
+    const char* name = rd.name.c_str();
+    const char* value = rd.value.c_str();
+    if(rd.name == "d") {
+      if(!parseWritePathData(value, node->path()))
+        return NULL;
+    }
+    else if(rd.name == "__bpts")
+      bpts = rd.value;
+    else if(rd.name == "class")
+      addClasses(node.get(), value);
+    else if(rd.name == "id")
+      node->setXmlId(value);
+    else if(rd.name == "__comx")
+      com.x = toReal(value, com.x);
+    else if(rd.name == "__comy")
+      com.y = toReal(value, com.y);
+    else if(rd.name == "__timestamp")
+      ts = strtoull(value, NULL, 0);
+    else if(strncmp(name, "fill", 4) == 0 || strncmp(name, "stroke", 6) == 0 || rd.name == "opacity")
+      node->setAttribute(name, value);  // parsed same as SvgParser
+    else
+      return NULL;
+  }
+  if(!rd.ok || !rd.selfClosing)
+    return NULL;
+  // d only holds first point of path if __bpts is present
+  if(!bpts.empty() && !decodePath(bpts.c_str(), node->path()))
+    return NULL;
+  Element* s = new Element(node.get());
+  s->setCom(com);
+  s->setTimestamp(ts);
+  return node.release();
+}
+
+bool Page::loadWritePage(const char* buff, size_t len)
+{
+  WritePageReader rd(buff, len);
+  std::unique_ptr<SvgDocument> doc(new SvgDocument());
+  Dim w = 0, h = 0;
+  rd.skipProlog();
+  if(!rd.openTag("svg"))
+    return false;
+  while(rd.nextAttr()) {
+    if(rd.name == "width" || rd.name == "height") {
+      if(!parseSvgPx(rd.value, rd.name == "width" ? &w : &h))
+        return false;
+    }
+    else if(rd.name == "class")
+      addClasses(doc.get(), rd.value.c_str());
+    else if(rd.name != "x" && rd.name != "y" && rd.name.compare(0, 5, "xmlns") != 0)
+      return false;
+  }
+  if(!rd.ok || rd.selfClosing || w <= 0 || h <= 0 || !doc->hasClass("write-page") || !rd.openTag("g"))
+    return false;
+  doc->setWidth(w);
+  doc->setHeight(h);
+  new Element(doc.get());
+
+  SvgG* content = new SvgG;
+  doc->addChild(content);
+  new Element(content);
+  while(rd.nextAttr()) {
+    if(rd.name == "class")
+      addClasses(content, rd.value.c_str());
+    else if(rd.name == "xruling" || rd.name == "yruling" || rd.name == "marginLeft"
+        || rd.name == "papercolor" || rd.name == "rulecolor")
+      content->setAttr(rd.name.c_str(), rd.value.c_str());
+    else if(rd.name != "width" && rd.name != "height")  // deprecated attributes are dropped
+      return false;
+  }
+  if(!rd.ok || !content->hasClass("write-content"))
+    return false;
+  content->removeClass("write-v3");
+
+  SvgG* rulenode = NULL;
+  Timestamp mints = MAX_TIMESTAMP, maxts = 0;
+  bool hasbookmark = false;
+  if(!rd.selfClosing) {
+    while(!rd.closeTag("g")) {
+      if(rd.openTag("path")) {
+        SvgPath* node = readWritePath(rd);
+        if(!node)
+          return false;
+        content->addChild(node);
+        Element* s = static_cast<Element*>(node->ext());
+        mints = std::min(mints, s->timestamp());
+        maxts = std::max(maxts, s->timestamp());
+        hasbookmark = hasbookmark || s->isBookmark();
+      }
+      else if(!rulenode && rd.openTag("g")) {
+        // std ruling is regenerated by onPageSizeChange(), so we only need a placeholder
+        rulenode = new SvgG;
+        doc->addChild(rulenode, content);
+        while(rd.nextAttr()) {
+          if(rd.name == "class")
+            addClasses(rulenode, rd.value.c_str());
+        }
+        if(!rd.ok || !rulenode->hasClass("ruleline") || !rulenode->hasClass("write-std-ruling"))
+          return false;
+        if(!rd.selfClosing && !rd.skipElement("g"))
+          return false;
+      }
+      else
+        return false;
+    }
+  }
+  if(!rd.closeTag("svg") || !rd.atEnd())
+    return false;
+
+  if(!rulenode) {
+    rulenode = new SvgG;
+    doc->addChild(rulenode, content);
+  }
+  svgDoc.reset(doc.release());
+  contentNode = content;
+  ruleNode = rulenode;
+  isCustomRuling = false;
+  if(hasbookmark)
+    document->bookmarksDirty = true;
+  if(strokeCount() > 0) {
+    minTimestamp = mints;
+    maxTimestamp = maxts;
+  }
+  return finishLoad();
+}
+
 bool Page::loadSVGFile(const char* filename, bool delayload)
 {
   // don't load over a dirty page (should never happen)
@@ -523,21 +1103,53 @@ bool Page::loadSVGFile(const char* filename, bool delayload)
   return loadStatus == LOAD_OK;
 }
 
-bool Page::ensureLoaded(bool checkmem)
+// markused = false must be passed if not on main thread
+bool Page::ensureLoaded(bool markused)
 {
   if(!document) return true;  // ghost page has no document
-  if(checkmem)
-    document->checkMemoryUsage(getPageNum());
-  return loadStatus == NOT_LOADED ?
-      (blockIdx >= 0 ? document->loadBgzPage(this) : loadSVGFile()) :
-      loadStatus == LOAD_OK;
+  if(markused)
+    lastUsed = ++document->pageUseCount;
+  if(loadStatus != NOT_LOADED)
+    return loadStatus == LOAD_OK;
+  if(document->loadPrefetched(this))
+    return true;
+  return blockIdx >= 0 || rawBlock ? document->loadBgzPage(this) : loadSVGFile();
+}
+
+static size_t nodeMemUsage(SvgNode* node)
+{
+  // node, Element, and typical attributes
+  size_t bytes = 256;
+  if(node->type() == SvgNode::PATH)
+    bytes += static_cast<SvgPath*>(node)->path()->size()*(sizeof(Point) + 1);
+  else if(node->type() == SvgNode::IMAGE) {
+    Image* image = static_cast<SvgImage*>(node)->image();
+    bytes += image ? image->dataLen() : 0;
+  }
+  else if(node->asContainerNode()) {
+    for(SvgNode* child : node->asContainerNode()->children())
+      bytes += nodeMemUsage(child);
+  }
+  return bytes;
+}
+
+// rough estimate of memory used by page content (nodes, path points, decoded images) for LRU unloading
+size_t Page::estimateMemUsage() const
+{
+  return loadStatus == LOAD_OK ? nodeMemUsage(svgDoc.get()) : 0;
 }
 
 void Page::unload()
 {
   ASSERT(dirtyCount == 0 && "Attempting to unload a dirty page!");
+  memUsage = 0;
+  memUsageDirtyCount = INT_MIN;
   bookmarks.clear();
   ruleNode = NULL;
+  strokeGrid.reset();
+  strokeOrder.clear();
+  if(document)
+    document->docPages.erase(svgDoc.get());
   svgDoc.reset(new SvgDocument(0, 0, props.width, props.height));
   initDoc();
   loadStatus = NOT_LOADED;
@@ -577,6 +1189,17 @@ void Page::onAddStroke(Element* s)
     minTimestamp = s->timestamp();
   if(s->timestamp() > maxTimestamp || strokeCount() == 1)
     maxTimestamp = s->timestamp();
+  if(strokeGrid)
+    strokeGrid->insert(s);
+  if(!strokeOrder.empty()) {
+    if(contentNode->children().back() == s->node)
+      strokeOrder[s] = nextStrokeOrder++;
+    else
+      strokeOrder.clear();
+  }
+  // strokes added while loading are indexed by finishLoad()
+  if(document && namedNodesIndexed && loadStatus == LOAD_OK)
+    document->addNamedNodes(this, s->node);
 }
 
 void Page::onRemoveStroke(Element* s)
@@ -592,6 +1215,44 @@ void Page::onRemoveStroke(Element* s)
     minTimestamp = MAX_TIMESTAMP;
     maxTimestamp = 0;
   }
+  if(document && namedNodesIndexed)
+    document->removeNamedNodes(this, s->node);
+  if(strokeGrid)
+    strokeGrid->remove(s);
+  strokeOrder.erase(s);
+}
+
+// must be called when bbox of a stroke on page is changed, e.g., by committing a transform
+void Page::onChangeStroke(Element* s)
+{
+  if(strokeGrid)
+    strokeGrid->update(s);
+}
+
+// candidates for hit testing, in document order (bottom to top) - caller must still check actual bbox
+std::vector<Element*> Page::strokesInRect(const Rect& r) const
+{
+  if(!strokeGrid) {
+    strokeGrid.reset(new ElementGrid);
+    for(Element* s : children())
+      strokeGrid->insert(s);
+  }
+  std::vector<Element*> res = strokeGrid->query(r);
+  if(res.size() < 2)
+    return res;
+  // elements added or removed directly w/o addStroke()/removeStroke() (e.g. free erase pieces) don't change
+  //  relative order of others, and aren't in strokeGrid anyway
+  if(strokeOrder.empty()) {
+    nextStrokeOrder = 0;
+    for(Element* s : children())
+      strokeOrder[s] = nextStrokeOrder++;
+  }
+  auto zpos = [this](const Element* s) {
+    auto it = strokeOrder.find(s);
+    return it != strokeOrder.end() ? it->second : SIZE_MAX;
+  };
+  std::sort(res.begin(), res.end(), [&zpos](const Element* a, const Element* b){ return zpos(a) < zpos(b); });
+  return res;
 }
 
 void Page::recalcTimeRange(bool force)
@@ -614,7 +1275,16 @@ void Page::recalcTimeRange(bool force)
 const char* Page::getHyperRef(Point pos) const
 {
   // support any href, not just those create by Write
-  SvgNode* node = contentNode->nodeAt(pos, false);
+  SvgNode* node = NULL;
+  for(Element* s : strokesInRect(Rect::centerwh(pos, 1, 1))) {
+    SvgNode* hit = s->node->nodeAt(pos, false);
+    if(hit && node) {
+      // overlapping elements - let nodeAt() find the topmost one
+      node = contentNode->nodeAt(pos, false);
+      break;
+    }
+    node = hit ? hit : node;
+  }
   const char* s = NULL;
   while(node && !(s = node->getStringAttr("xlink:href", NULL)) && !(s = node->getStringAttr("href", NULL)))
     node = node->parent();
@@ -633,3 +1303,121 @@ void Page::setSelected(bool sel)
     svgDoc->setDirty(SvgNode::PIXELS_DIRTY);
   isSelected = sel;
 }
+
+// ElementGrid
+
+static int gridCell(Dim x)
+{
+  return int(std::max(Dim(INT_MIN/2), std::min(Dim(INT_MAX/2), std::floor(x/ElementGrid::cellSize))));
+}
+
+static uint64_t gridKey(int cx, int cy)
+{
+  return (uint64_t(uint32_t(cx)) << 32) | uint32_t(cy);
+}
+
+// returns false if element w/ bbox r should be stored in large list
+bool ElementGrid::cellRange(const Rect& r, int* cx0, int* cy0, int* cx1, int* cy1) const
+{
+  if(!r.isValid())
+    return false;
+  *cx0 = gridCell(r.left);
+  *cy0 = gridCell(r.top);
+  *cx1 = gridCell(r.right);
+  *cy1 = gridCell(r.bottom);
+  return int64_t(*cx1 - *cx0 + 1)*(*cy1 - *cy0 + 1) <= maxCells;
+}
+
+void ElementGrid::insert(Element* s)
+{
+  Rect r = s->bbox();
+  rects[s] = r;
+  int cx0, cy0, cx1, cy1;
+  if(!cellRange(r, &cx0, &cy0, &cx1, &cy1)) {
+    large.push_back({s, r});
+    return;
+  }
+  minX = std::min(minX, cx0);
+  minY = std::min(minY, cy0);
+  maxX = std::max(maxX, cx1);
+  maxY = std::max(maxY, cy1);
+  for(int cy = cy0; cy <= cy1; ++cy) {
+    for(int cx = cx0; cx <= cx1; ++cx)
+      cells[gridKey(cx, cy)].push_back({s, r});
+  }
+}
+
+static void eraseEntry(std::vector<ElementGrid::Entry>& entries, Element* s)
+{
+  for(size_t ii = 0; ii < entries.size(); ++ii) {
+    if(entries[ii].s == s) {
+      entries[ii] = entries.back();
+      entries.pop_back();
+      return;
+    }
+  }
+}
+
+bool ElementGrid::remove(Element* s)
+{
+  auto it = rects.find(s);
+  if(it == rects.end())
+    return false;
+  Rect r = it->second;
+  rects.erase(it);
+  int cx0, cy0, cx1, cy1;
+  if(!cellRange(r, &cx0, &cy0, &cx1, &cy1)) {
+    eraseEntry(large, s);
+    return true;
+  }
+  for(int cy = cy0; cy <= cy1; ++cy) {
+    for(int cx = cx0; cx <= cx1; ++cx) {
+      auto cell = cells.find(gridKey(cx, cy));
+      if(cell == cells.end())
+        continue;
+      eraseEntry(cell->second, s);
+      if(cell->second.empty())
+        cells.erase(cell);
+    }
+  }
+  return true;
+}
+
+std::vector<Element*> ElementGrid::query(const Rect& r) const
+{
+  std::vector<Element*> res;
+  for(const Entry& e : large) {
+    if(!e.r.isValid() || e.r.intersects(r))
+      res.push_back(e.s);
+  }
+  if(cells.empty() || !r.isValid())
+    return res;
+  int cx0 = std::max(minX, gridCell(r.left)), cy0 = std::max(minY, gridCell(r.top));
+  int cx1 = std::min(maxX, gridCell(r.right)), cy1 = std::min(maxY, gridCell(r.bottom));
+  if(cx0 > cx1 || cy0 > cy1)
+    return res;
+  // an element is in every cell it overlaps, so only report it from the cell containing the top left corner
+  //  of its intersection with r
+  auto visit = [&](int cx, int cy, const std::vector<Entry>& entries) {
+    for(const Entry& e : entries) {
+      if(e.r.intersects(r) && gridCell(std::max(e.r.left, r.left)) == cx && gridCell(std::max(e.r.top, r.top)) == cy)
+        res.push_back(e.s);
+    }
+  };
+  // for a huge query rect, it's cheaper to just visit all occupied cells
+  if(int64_t(cx1 - cx0 + 1)*(cy1 - cy0 + 1) > int64_t(cells.size())) {
+    for(auto& cell : cells)
+      visit(int32_t(cell.first >> 32), int32_t(uint32_t(cell.first)), cell.second);
+  }
+  else {
+    for(int cy = cy0; cy <= cy1; ++cy) {
+      for(int cx = cx0; cx <= cx1; ++cx) {
+        auto cell = cells.find(gridKey(cx, cy));
+        if(cell != cells.end())
+          visit(cx, cy, cell->second);
+      }
+    }
+  }
+  return res;
+}
+
@@ -3,6 +3,7 @@
 #include <vector>
 #include <string>
 #include <functional>
+#include <unordered_map>
 #include "ulib/fileutil.h"
 #include "element.h"
 
@@ -19,8 +20,36 @@ public:
   PageProperties(Dim w=0, Dim h=0, Dim xr=0, Dim yr=0, Dim ml=0, Color c=Color::WHITE, Color rc=Color::BLUE);
 };
 
+// Uniform grid over Element bboxes so that spatial queries only visit elements near the query rect, not every
+//  element on the page.  Bbox is recorded when element is inserted, so update() must be called whenever an
+//  element's bbox changes (other than by a pending transform which is later reset)
+class ElementGrid
+{
+public:
+  void insert(Element* s);
+  bool remove(Element* s);
+  void update(Element* s) { if(remove(s)) insert(s); }
+  // elements whose recorded bbox intersects r (in no particular order - see Page::strokesInRect())
+  std::vector<Element*> query(const Rect& r) const;
+
+  struct Entry { Element* s; Rect r; };
+
+  static Dim cellSize;
+  static int maxCells;  // elements covering more cells than this are kept in a separate list
+
+private:
+  bool cellRange(const Rect& r, int* cx0, int* cy0, int* cx1, int* cy1) const;
+
+  std::unordered_map<uint64_t, std::vector<Entry>> cells;
+  std::vector<Entry> large;  // large elements and elements w/o valid bbox
+  std::unordered_map<Element*, Rect> rects;
+  // extent of cells ever occupied
+  int minX = INT_MAX, minY = INT_MAX, maxX = INT_MIN, maxY = INT_MIN;
+};
+
 // 1 page = 1 <svg> node
 class Document;
+struct BgzBlock;
 
 class Page {
 public:
@@ -39,7 +68,16 @@ public:
   // dirtyCount is managed by undo system; page needs to be written out if != 0
   int dirtyCount = 0;
   //int autoSavedDirtyCount = NOT_AUTO_SAVED;  // dirtyCount value of last autosave
+  // for LRU unloading: estimated size of loaded content (valid if memUsageDirtyCount == dirtyCount) and
+  //  value of Document::pageUseCount when page was last used
+  size_t memUsage = 0;
+  int memUsageDirtyCount = INT_MIN;
+  uint64_t lastUsed = 0;
   int blockIdx = -1;
+  int pageNum = -1;  // index in document->pages, maintained by Document; -1 if not in a document
+  bool namedNodesIndexed = false;  // ids of all named nodes in page are in document->namedNodes
+  // compressed block of unloaded page deleted from document or moved from another document
+  std::shared_ptr<BgzBlock> rawBlock;
   std::string fileName;
   std::string autoSaveFileName;
 
@@ -48,6 +86,13 @@ public:
   //  transform, so this is really just a special case of that
   Dim scaleFactor = 1;
   bool isSelected = false;
+  // spatial index of content elements; built on first use and discarded when page is loaded or unloaded
+  mutable std::unique_ptr<ElementGrid> strokeGrid;
+  // sequence number of each content element in document (z) order, for sorting strokesInRect() results;
+  //  built on first use, then appended strokes get the next number and removed strokes are just dropped -
+  //  only inserting a stroke below others requires renumbering (on next use)
+  mutable std::unordered_map<const Element*, size_t> strokeOrder;
+  mutable size_t nextStrokeOrder = 0;
 
   Page(Dim w=0, Dim h=0, int idx = -1);
   Page(const PageProperties& _props, const SvgContainerNode* ruling = NULL);
@@ -57,7 +102,7 @@ public:
   //void changeSpacing(Dim newxruling, Dim newyruling, Dim newmarginLeft);
   void onPageSizeChange();
   void generateRuleLayer(Color pageColor, Dim w, Dim h);
-  int getPageNum() const;
+  int getPageNum() const { return pageNum; }
   int getLine(Dim y) const;
   int getLine(const Element* s) const;
   std::function<bool(const Element* a, const Element* b)> cmpRuled();
@@ -82,14 +127,19 @@ public:
   void removeStroke(Element* s);
   void onAddStroke(Element* s);
   void onRemoveStroke(Element* s);
+  void onChangeStroke(Element* s);
+  std::vector<Element*> strokesInRect(const Rect& r) const;
   const char* getHyperRef(Point pos) const;
   SvgNode* findNamedNode(const char* idstr) const;
 
-  bool saveSVG(IOStream& file, Dim x = 0, Dim y = 0);
+  bool saveSVG(IOStream& file, Dim x = 0, Dim y = 0, bool binpaths = false);
   bool saveSVGFile(const char* filename);
   bool loadSVG(SvgDocument* doc);
+  bool loadWritePage(const char* buff, size_t len);
+  bool finishLoad();
   bool loadSVGFile(const char* filename = NULL, bool delayload = false);
-  bool ensureLoaded(bool checkmem = true);
+  bool ensureLoaded(bool markused = true);
+  size_t estimateMemUsage() const;
   void migrateLegacySVG();
   void contentToRuling();
   void setSelected(bool sel);
@@ -12,12 +12,12 @@
 #include "clippingview.h"
 #include "scribbleinput.h"
 #include "documentlist.h"
+#include "docconvert.h"
 #include "rulingdialog.h"
 #include "pentoolbar.h"
 #include "linkdialog.h"
 #include "configdialog.h"
 #include "touchwidgets.h"
-#include "usvg/pdfwriter.h"
 #include "ulib/unet.h"
 #include "usvg/svgparser.h"
 #if PLATFORM_WIN
@@ -119,6 +119,8 @@ ScribbleApp::ScribbleApp(int argc, char* argv[])
   }
 #endif
   createPath(tempPath.c_str());
+  thumbCachePath = FSPath(savedPath, "thumbcache/").c_str();
+  docIndexPath = FSPath(savedPath, "docindex.bin").c_str();
 
   cfg = new ScribbleConfig;
   if(!cfg->loadConfigFile(cfgFile.c_str())) {
@@ -477,7 +479,7 @@ void ScribbleApp::loadConfig()
         if(d->isModified() && d->fileName()[0]) {
           // delay autosave until pen is lifted
           if(activeDoc()->getActiveMode() == MODE_NONE)
-            d->saveDocument();
+            d->saveDocument((IOStream*)NULL, Document::SAVE_BACKGROUND);
           else
             d->autoSaveReq = true;
         }
@@ -755,6 +757,10 @@ bool ScribbleApp::sdlEventHandler(SDL_Event* event)
           scribbleMode->scribbleDone();  // revert to previous mode
         win->updateMode();
       }
+      else if(event->user.code == SAVE_DONE) {
+        for(ScribbleDoc* d : scribbleDocs)
+          d->checkBackgroundSave();
+      }
       else if(event->user.code == IAP_COMPLETE) {
         delete ScribbleArea::watermark;
         ScribbleArea::watermark = NULL;
@@ -1454,7 +1460,7 @@ std::string ScribbleApp::execDocumentList(int mode, const char* exts, bool cance
   return "";
 #else
   if(!documentList)
-    documentList = new DocumentList(docRoot.c_str(), tempPath.c_str());
+    documentList = new DocumentList(docRoot.c_str(), tempPath.c_str(), thumbCachePath.c_str(), docIndexPath.c_str());
   documentList->setup(win, DocumentList::Mode_t(mode), exts, cancelable);
   execWindow(documentList);
   return documentList->result > 0 ? documentList->selectedFile : "";
@@ -1847,6 +1853,9 @@ bool ScribbleApp::checkExtModified(ScribbleDoc* doc)
   return false;
 #else
   std::string filename = doc->fileName();
+  // file may be in the middle of being written by background save
+  if(doc->bgSavePending)
+    doc->checkBackgroundSave(true);
   if(filename.empty() || doc->fileLastMod == 0 || !cfg->Bool("warnExtModified"))
     return false;
   const Timestamp lastmod = getFileMTime(filename.c_str());
@@ -2102,18 +2111,7 @@ void clipboardFromBuffer(const unsigned char* buff, size_t len, int is_image)
 
 void ScribbleApp::writePDF(std::ostream& strm)
 {
-  Document* doc = activeDoc()->document;
-  PdfWriter pdf(doc->numPages());
-  pdf.anyHref = true;  // hack to work around our hack for links
-  //pdf.compressionLevel = 0;  // for debugging
-  Dim ptsPerDim = 72.0/150;
-  pdf.resolveLink = [doc](const char* href, int* pgnum){ return doc->findNamedNode(href, pgnum); };
-  for(Page* page : doc->pages) {
-    page->ensureLoaded();
-    pdf.newPage(page->width(), page->height(), ptsPerDim);
-    pdf.drawNode(page->svgDoc.get());
-  }
-  pdf.write(strm);
+  DocConverter::writePDF(activeDoc()->document, strm);
 }
 
 bool ScribbleApp::writePDF(const std::string& filename)
@@ -2782,6 +2780,21 @@ std::string ScribbleApp::runTest(std::string runtype)
     test.performanceTest();
     return test.resultStr;
   }
+  else if(runtype == "lassotest") {
+    ScribbleTest test(activeDoc(), bookmarkArea, scribbleMode);
+    test.lassoBenchmark();
+    return test.resultStr;
+  }
+  else if(runtype == "pathtest") {
+    ScribbleTest test(activeDoc(), bookmarkArea, scribbleMode);
+    test.pathEncodingBenchmark();
+    return test.resultStr;
+  }
+  else if(runtype == "erasetest") {
+    ScribbleTest test(activeDoc(), bookmarkArea, scribbleMode);
+    test.eraseBenchmark();
+    return test.resultStr;
+  }
   else if(runtype == "inputtest") {
     // see 83a76eea88eb for TouchInputFilter::notifyTouchEvent test
     ScribbleTest test(activeDoc(), bookmarkArea, scribbleMode);
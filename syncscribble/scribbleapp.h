@@ -134,6 +134,8 @@ public:
 
   std::string tempPath;
   std::string savedPath;
+  std::string thumbCachePath;  // decoded document thumbnails for DocumentList
+  std::string docIndexPath;  // DocIndex metadata for documents under docRoot
   //std::string backupPath;
   std::string docRoot;
   std::string clippingsPath;
@@ -144,7 +146,7 @@ public:
   bool hasI18n = false;
   static Uint32 scribbleSDLEvent;
   enum scribbleSDLEventCode {INSERT_IMAGE=1, UPDATE_CHECK,
-      STORAGE_PERMISSION, DISMISS_DIALOG, SIMULATE_PEN_BTN, IAP_COMPLETE, APP_SUSPEND};
+      STORAGE_PERMISSION, DISMISS_DIALOG, SIMULATE_PEN_BTN, IAP_COMPLETE, APP_SUSPEND, SAVE_DONE};
 
   ScribbleArea* activeArea() const { return mActiveArea; }
   ScribbleDoc* activeDoc() const;
@@ -17,6 +17,7 @@ const Dim ScribbleArea::GROW_TRIGGER = 1.625;  // in multiples of GROW_STEP or r
 const Dim ScribbleArea::GROW_EXTRA = 2.5;  // in multiples of GROW_STEP or ruling
 const Dim ScribbleArea::AUTOSCROLL_BORDER = 60;
 const Dim ScribbleArea::MIN_CURSOR_RADIUS = 2;
+const Dim ScribbleArea::PREFETCH_SECS = 0.5;  // prefetch pages we'll reach within this time
 const Color ScribbleArea::BACKGROUND_COLOR = 0xFF444444;
 
 Image* ScribbleArea::watermark = NULL;
@@ -47,6 +48,7 @@ void ScribbleArea::loadConfig(ScribbleConfig* _cfg)
   reflowWordSep = cfg->Float("minWordSep", 0.3f);
   selColMode = RuledSelector::ColMode(cfg->Int("columnDetectMode"));
   drawCursor = cfg->Int("drawCursor");
+  maxPrefetch = cfg->Int("prefetchPages");
   //scribbleInput->enableHoverEvents = (drawCursor == 2);
 #ifdef ONE_TIME_TIPS
   showHelpTips = scribbleDoc->scribbleMode && (app->oneTimeTip("ghostpage") || app->oneTimeTip("scalesel") ||
@@ -250,6 +252,8 @@ void ScribbleArea::roundZoom(Dim px, Dim py)
 void ScribbleArea::doPan(Dim dx, Dim dy)
 {
   ScribbleView::doPan(dx, dy);
+  if(viewMode != VIEWMODE_SINGLE)
+    prefetchPages(viewMode == VIEWMODE_HORZ ? dx : dy);
   if(viewMode == VIEWMODE_SINGLE || (currMode != MODE_NONE && currMode != MODE_PAN))
     return;
 
@@ -278,6 +282,26 @@ void ScribbleArea::doPan(Dim dx, Dim dy)
 #endif
 }
 
+// load upcoming pages of delay-loaded document on worker threads; number of pages loaded ahead in the
+//  direction of scrolling increases with scroll speed so fast flings don't stall on unloaded pages
+void ScribbleArea::prefetchPages(Dim dpos)
+{
+  if(maxPrefetch <= 0)
+    return;
+  Timestamp t = mSecSinceEpoch();
+  Dim pagesize = viewMode == VIEWMODE_HORZ ? currPage->width() : currPage->height();
+  // pan offset increases when scrolling toward beginning of document
+  Dim v = pagesize > 0 ? -dpos*1000/(mScale*pagesize*std::max(Timestamp(1), t - prevPanTime)) : 0;
+  // reset after a pause in scrolling
+  panVelocity = t - prevPanTime > 250 ? 0 : 0.7*panVelocity + 0.3*v;
+  prevPanTime = t;
+  int nahead = std::min(maxPrefetch, 1 + int(std::abs(panVelocity)*PREFETCH_SECS));
+  if(panVelocity < 0)
+    scribbleDoc->document->prefetchPages(currPageNum - nahead, currPageNum + 1);
+  else
+    scribbleDoc->document->prefetchPages(currPageNum - 1, currPageNum + nahead);
+}
+
 void ScribbleArea::pageSizeChanged()
 {
   repaintAll();
@@ -353,7 +377,9 @@ void ScribbleArea::setPageNum(int pagenum)
     groupStrokes();
     currPage = page(pagenum);
     currPageNum = pagenum;
-    currPage->ensureLoaded();  // needed for memory usage check if nothing else
+    currPage->ensureLoaded();  // also marks page as recently used
+    if(viewMode == VIEWMODE_SINGLE && maxPrefetch > 0)
+      scribbleDoc->document->prefetchPages(currPageNum - 1, currPageNum + 1);
     if(viewMode == VIEWMODE_SINGLE)
       pageSizeChanged();
     else {
@@ -412,8 +438,10 @@ void ScribbleArea::setStrokeProperties(const StrokeProperties& props, bool undoa
     scribbleDoc->endAction();
   }
   else {
-    for(Element* s : currSelection->strokes)
+    for(Element* s : currSelection->strokes) {
       s->setProperties(props);
+      currSelection->page->onChangeStroke(s);
+    }
   }
   // adjust selection region to account for possible stroke width change
   currSelection->shrink();
@@ -1099,6 +1127,7 @@ void ScribbleArea::setSelProperties(const StrokeProperties* props, const char* t
           if(s->node->hasTransform()) {
             t->applyTransform(s->node->getTransform());
             t->commitTransform();
+            currPage->onChangeStroke(t);
           }
           currSelection->addStroke(t);
           sorted.push_back(t);
@@ -1217,29 +1246,32 @@ void ScribbleArea::freeErase(Point prevpos, Point pos)
   Dim radius = ERASEFREE_RADIUS/mZoom;
   bool touched = false;
   Rect erasebox = Rect::corners(prevpos, pos).pad(radius);
-  auto strokes = currPage->children();
-  for(auto ii = strokes.begin(); ii != strokes.end();) {
-    Element* s = *ii++;
+  // pieces are not added to page's spatial index until erasing is finished
+  std::vector<Element*> strokes = currPage->strokesInRect(erasebox);
+  strokes.insert(strokes.end(), freeErasePieces->strokes.begin(), freeErasePieces->strokes.end());
+  for(Element* s : strokes) {
     if(!s->isSelected(tempSelection) && erasebox.intersects(s->bbox())) {
       if(s->isSelected(freeErasePieces)) {
         //Rect oldbbox = s->bbox();
-        touched = s->freeErase(prevpos, pos, radius) || touched;
+        touched = s->freeErase(prevpos, pos, radius, eraseScratch) || touched;
           //currPage->growDirtyRect(oldbbox.rectUnion(s->bbox()));
       }
-      else {
+      else if(s->freeEraseTest(prevpos, pos, radius, eraseScratch)) {
+        // only clone strokes actually touched by eraser (not just its bbox)
         Element* s2 = s->cloneNode();
-        if(s2->freeErase(prevpos, pos, radius)) {
-          Element* nexts = ii != strokes.end() ? *ii : NULL;
-          currPage->contentNode->addChild(s2->node, nexts ? nexts->node : NULL);
-          ii = std::find(strokes.begin(), strokes.end(), nexts);
-          freeErasePieces->addStroke(s2);
-          // hide original stroke
-          tempSelection->addStroke(s);
-          //currPage->growDirtyRect(s->bbox());
-          touched = true;
+        if(!s2->freeErase(prevpos, pos, radius, eraseScratch)) {
+          // freeEraseTest() and freeErase() should always agree
+          ASSERT(0 && "freeErase() failed after positive freeEraseTest()");
+          s2->deleteNode();
+          continue;
         }
-        else
-          s2->deleteNode();  //delete s2;
+        // insert directly below original, which is hidden and then removed when erasing is finished
+        currPage->contentNode->addChild(s2->node, s->node);
+        freeErasePieces->addStroke(s2);
+        // hide original stroke
+        tempSelection->addStroke(s);
+        //currPage->growDirtyRect(s->bbox());
+        touched = true;
       }
     }
   }
@@ -1998,8 +2030,10 @@ void ScribbleArea::doReleaseEvent(const InputEvent& event)
           ii = std::find(strokes.begin(), strokes.end(), nexts);
           continue;
         }
-        else
+        else {
           scribbleDoc->history->addItem(new StrokeAddedItem(s, currPage, nexts));
+          currPage->onAddStroke(s);
+        }
       }
     }
     delete freeErasePieces;
@@ -144,6 +144,7 @@ protected:
   void viewSelection();
   void freeErase(Point prevpos, Point pos);
   bool saveCurrPos(int newpagenum, Point newpos);
+  void prefetchPages(Dim dpos);
 
   Point getPageOrigin(int pagenum) const;
   int dimToPageNum(const Point& pos) const;
@@ -179,6 +180,10 @@ protected:
   int drawCursor = 0;
   Dim lineDrawPressure = 1;
   bool showHelpTips = false;
+  // for background loading of pages ahead of scrolling
+  int maxPrefetch = 0;
+  Timestamp prevPanTime = 0;
+  Dim panVelocity = 0;  // pages per second
 
   // for erase ruled
   int eraseCurrLine;
@@ -207,6 +212,7 @@ protected:
   Selection* currSelection = NULL;
   // selection for stroke fragments produced by free eraser
   Selection* freeErasePieces = NULL;
+  std::vector<PenPoint> eraseScratch;  // working space for Element::freeErase()
   int currSelPageNum = 0;
   Rect selBGRect;
 
@@ -245,5 +251,6 @@ protected:
   static const Dim GROW_EXTRA;  // in multiples of GROW_STEP or ruling
   static const Dim AUTOSCROLL_BORDER;
   static const Dim MIN_CURSOR_RADIUS;
+  static const Dim PREFETCH_SECS;
   static const Color BACKGROUND_COLOR;
 };
@@ -108,6 +108,9 @@ void ScribbleConfig::init()
 
   // compression level
   cfg["compressLevel"] = 2;
+  // store path points in compact binary encoding in .svgz files - faster save and load, smaller files, but
+  //  strokes can only be read by Write
+  cfg["binaryPaths"] = 0;
   // save documents as a single file instead of one SVG file per page ... deprecated, not exposed in UI
   cfg["singleFile"] = 1;
   // save unmodified files (to update thumbnail and viewing position)?
@@ -116,6 +119,10 @@ void ScribbleConfig::init()
   cfg["savePrompt"] = 0;
   // autosave interval in seconds; set <= 0 to disable
   cfg["autoSaveInterval"] = 0; //120;
+  // write autosaves from a snapshot on separate thread so editing can continue (.svgz only)
+  cfg["backgroundSave"] = PLATFORM_IOS || PLATFORM_EMSCRIPTEN ? 0 : 1;
+  // max number of pages ahead of view to load on worker threads when scrolling; 0 to disable
+  cfg["prefetchPages"] = 8;
   // Use custom document list dialog to open and create documents
   cfg["useDocList"] = 1;
   // doc list icon (thumbnail) size
@@ -182,7 +189,7 @@ void ScribbleConfig::init()
   cfg["syncViewPageOffset"] = 0;
   cfg["syncMsgLevel"] = -100;  // only show messages w/ level >= this value
   cfg["perfTrace"] = 0;  // print performance traces?
-  cfg["maxMemoryMB"] = 1024;  // start unloading pages when memory usage hits 1GB
+  cfg["maxMemoryMB"] = 1024;  // unload least recently used pages when estimated page memory exceeds 1GB
 
   // floats
   // page defaults - initial values are determined from screen size on first run
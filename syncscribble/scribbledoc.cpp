@@ -95,7 +95,8 @@ void ScribbleDoc::closeDocument()
     delete scribbleSync;
   for(unsigned int ii = 0; ii < views.size(); ii++)
     views[ii]->reset();
-  delete document;
+  bgSavePending = false;
+  delete document;  // waits for background save
   delete cfg;
   ghostPage.reset();
   scribbleSync = NULL;
@@ -149,8 +150,7 @@ Image ScribbleDoc::extractThumbnail(const char* filename)
   FSPath fileinfo(filename);
   if(fileinfo.extension() == "svgz" || fileinfo.extension() == "gz") {
     minigz_io_t zistrm(istrm);
-    auto blockInfo = bgz_get_index(zistrm);
-    std::stringstream inf_block;
+    auto blockInfo = Document::readBgzIndex(&istrm);
     if(blockInfo.empty() || !bgz_read_block(zistrm, &blockInfo.back() - 1, minigz_io_t(infstrm)))
       return Image(0,0);
     buff = StringRef(infstrm.data(), infstrm.size());  //buff.len = zstrm.readp((void**)&buff.str, SIZE_MAX);
@@ -234,11 +234,19 @@ bool ScribbleDoc::saveDocument(IOStream* strm, Document::saveflags_t flags)
 {
   if(!strm)
     flags |= Document::SAVE_BGZ_PARTIAL;  // whole file will be written if this is not set
+  // background save only supported for in-place save of .svgz
+  if(strm || !cfg->Bool("backgroundSave") || FSPath(fileName()).extension() != "svgz")
+    flags &= ~Document::SAVE_BACKGROUND;
+  else if((flags & Document::SAVE_BACKGROUND) && document->saveInProgress())
+    return true;  // document will remain modified, so it will be saved on next autosave
 
   doCancelAction();
   // when saving a copy for sharing, set position to start of document
   updateDocConfig(flags);
   flags |= cfg->Int("compressLevel", 2) << 24;  // ignored for uncompressed formats
+  // copies may be opened by other apps, so always use plain SVG paths
+  if(cfg->Bool("binaryPaths") && !(flags & Document::SAVE_COPY))
+    flags |= Document::SAVE_BINARY_PATHS;  // ignored for formats other than .svgz
 
   bool ok = false;
   if(cfg->Bool("saveThumbnail")) {
@@ -254,10 +262,13 @@ bool ScribbleDoc::saveDocument(IOStream* strm, Document::saveflags_t flags)
     Image thumbnail(240, 400, Image::PNG);
     activeArea->drawThumbnail(&thumbnail);
     auto buff = base64_encode(thumbnail.encode(Image::PNG));
-    ok = document->save(strm, (char*)buff.data(), flags);
+    ok = (flags & Document::SAVE_BACKGROUND) ? saveBackground((char*)buff.data(), flags)
+        : document->save(strm, (char*)buff.data(), flags);
   }
   else
-    ok = document->save(strm, NULL, flags);
+    ok = (flags & Document::SAVE_BACKGROUND) ? saveBackground(NULL, flags) : document->save(strm, NULL, flags);
+  if(flags & Document::SAVE_BACKGROUND)
+    return ok;  // fileLastMod and UI updated by checkBackgroundSave()
   if(ok) {
 #if !PLATFORM_IOS
     fileLastMod = getFileMTime(fileName());
@@ -526,9 +537,20 @@ void ScribbleDoc::movePage(int oldpagenum, int newpagenum)
   if(oldpagenum < 0 || oldpagenum >= document->numPages() || oldpagenum == newpagenum)
     return;
   clearSelection();  // otherwise Element.m_selection won't be cleared on copy!
-  Page* newpage = new Page;
-  // this replaces previous method of serializing and deserializing
-  newpage->loadSVG(document->pages[oldpagenum]->svgDoc->clone());
+  Page* oldpage = document->pages[oldpagenum];
+  Page* newpage = NULL;
+  if(oldpage->loadStatus == Page::NOT_LOADED && (oldpage->blockIdx >= 0 || oldpage->rawBlock))
+    newpage = new Page(oldpage->props.width, oldpage->props.height, oldpage->blockIdx);
+  else {
+    newpage = new Page;
+    // this replaces previous method of serializing and deserializing
+    newpage->loadSVG(oldpage->svgDoc->clone());
+    if(oldpage->dirtyCount == 0)
+      newpage->blockIdx = oldpage->blockIdx;
+  }
+  // unmodified page can be saved by copying its compressed block
+  if(oldpage->dirtyCount == 0)
+    newpage->rawBlock = oldpage->rawBlock;
   startAction(oldpagenum | UndoHistory::MULTIPAGE);
   document->deletePage(oldpagenum);
   document->insertPage(newpage, newpagenum);
@@ -794,6 +816,37 @@ void ScribbleDoc::pageSizeChanged()
     views[ii]->pageSizeChanged();
 }
 
+bool ScribbleDoc::saveBackground(const char* thumb, Document::saveflags_t flags)
+{
+  bgSavePending = document->saveBackground(thumb, flags, [](){
+    SvgGui::pushUserEvent(ScribbleApp::scribbleSDLEvent, ScribbleApp::SAVE_DONE);
+  });
+  if(bgSavePending)
+    return true;
+  // fall back to normal save if background save could not be started
+  if(!document->save(NULL, thumb, flags & ~Document::SAVE_BACKGROUND))
+    return false;
+#if !PLATFORM_IOS
+  fileLastMod = getFileMTime(fileName());
+#endif
+  app->refreshUI(this, (1 << UIState::SaveDoc));
+  return true;
+}
+
+// finish background save if complete (or if wait is true); must be called on main thread
+void ScribbleDoc::checkBackgroundSave(bool wait)
+{
+  if(!bgSavePending || (!wait && document->saveInProgress() && !document->saveFinished))
+    return;
+  bgSavePending = false;
+  if(document->waitForSave()) {
+#if !PLATFORM_IOS
+    fileLastMod = getFileMTime(fileName());
+#endif
+    app->refreshUI(this, (1 << UIState::SaveDoc));
+  }
+}
+
 void ScribbleDoc::repaintAll()
 {
   for(unsigned int ii = 0; ii < nViews; ii++)
@@ -805,7 +858,7 @@ void ScribbleDoc::doRefresh()
   if(autoSaveReq && getActiveMode() == MODE_NONE) {
     autoSaveReq = false;
     if(fileName()[0])
-      saveDocument();
+      saveDocument((IOStream*)NULL, Document::SAVE_BACKGROUND);
   }
   // won't actually repaint unless dirty
   // shouldn't we just check all (visible) pages? then we wouldn't need explicit repaintAll calls (?)
@@ -813,6 +866,14 @@ void ScribbleDoc::doRefresh()
     dirtyPage(view->currPageNum);  // first build directRectDim from each potentially dirty page
   for(ScribbleArea* view : views)
     view->reqRepaint();  // then update dirtyRectScreen for each view and set PIXELS_DIRTY if needed
+  // unload least recently used pages if over memory budget
+  document->checkMemoryUsage([this](int pagenum){
+    for(ScribbleArea* view : views) {
+      if(view->currPageNum == pagenum || view->currSelPageNum == pagenum || view->isPageVisible(pagenum))
+        return true;
+    }
+    return false;
+  });
 
   if(document->bookmarksDirty) {
     app->repaintBookmarks();
@@ -29,6 +29,8 @@ public:
   Document::loadresult_t openDocument(IOStream* strm, bool delayload = true);
   bool saveDocument(const char* filename, Document::saveflags_t flags = Document::SAVE_NORMAL);
   bool saveDocument(IOStream* strm = NULL, Document::saveflags_t flags = Document::SAVE_NORMAL);
+  bool saveBackground(const char* thumb, Document::saveflags_t flags);
+  void checkBackgroundSave(bool wait = false);
   void resetDocPrefs();
   void openSharedDoc(const char* server, const pugi::xml_node& xml, bool master);
   bool checkAndClearErrors(bool forceload = false);
@@ -110,6 +112,7 @@ public:
   std::unique_ptr<Page> ghostPage;
   Timestamp fileLastMod = 0;
   bool autoSaveReq = false;
+  bool bgSavePending = false;
 
   StrokeBuilder* strokeBuilder = NULL;
 };
@@ -199,7 +199,7 @@ void Selection::doSelect()
     }
   }
   // set selected flag for selected strokes and add to list
-  for(Element* node : sourceNode->children()) {
+  auto selectNode = [&](Element* node) {
     // fetch bbox and compare ourselves or Stroke::isContained(...)
     // note that we don't steal elements from another selection (selection() must be NULL)
     if((!node->selection() || selMode == SELMODE_PASSIVE) && selector->selectHit(node)) {
@@ -208,6 +208,16 @@ void Selection::doSelect()
       dirty.rectUnion(node->bbox());
       strokes.push_back(node);
     }
+  };
+  // use page's spatial index if selector can tell us where hits are possible
+  Rect hitbounds = selector->hitBounds();
+  if(hitbounds.isValid()) {
+    for(Element* node : page->strokesInRect(hitbounds))
+      selectNode(node);
+  }
+  else {
+    for(Element* node : sourceNode->children())
+      selectNode(node);
   }
 }
 
@@ -293,6 +303,7 @@ void Selection::commitTransform()
         hist->addItem(new StrokeTranslateItem(node, page, node->pendingTransform().xoffset(), node->pendingTransform().yoffset()));
     }
     node->commitTransform();
+    page->onChangeStroke(node);
   }
   transform.reset();
 }
@@ -304,6 +315,7 @@ void Selection::stealthTransform(const ScribbleTransform& tf)
   for(Element* s : strokes) {
     s->applyTransform(tf);
     s->commitTransform();
+    page->onChangeStroke(s);
   }
   invalidateBBox();
 }
@@ -375,6 +387,7 @@ void Selection::setStrokeProperties(const StrokeProperties& props)
       removeStroke(s);
       page->removeStroke(s);
       t->setProperties(props);
+      page->onChangeStroke(t);
     }
     else {
       StrokeChangedItem* undoitem = new StrokeChangedItem(s, page);
@@ -382,6 +395,7 @@ void Selection::setStrokeProperties(const StrokeProperties& props)
         page->document->history->addItem(undoitem);
       else
         delete undoitem;
+      page->onChangeStroke(s);
     }
   }
 }
@@ -417,6 +431,8 @@ void Selection::ungroup()
           if(!t->node->getAttr(attr.name()) && attr.stdAttr() != SvgAttr::UNKNOWN)
             t->node->setAttr(attr);
         }
+        // inherited stroke-width changes bounds too
+        page->onChangeStroke(t);
         // should we also copy class?
         addStroke(t);
       }
@@ -624,51 +640,100 @@ Selector::~Selector()
 
 // PathSelector class
 
+// Each path segment is tested as a capsule (all points within radius of segment) in a single pass, instead of
+//  subdividing segment and testing each point
+
+static Dim cross(Point a, Point b) { return a.x*b.y - a.y*b.x; }
+
+// squared distance between segments a0-a1 and b0-b1
+static Dim segDist2(Point a0, Point a1, Point b0, Point b1)
+{
+  Dim d0 = cross(a1 - a0, b0 - a0), d1 = cross(a1 - a0, b1 - a0);
+  Dim d2 = cross(b1 - b0, a0 - b0), d3 = cross(b1 - b0, a1 - b0);
+  if(((d0 > 0 && d1 < 0) || (d0 < 0 && d1 > 0)) && ((d2 > 0 && d3 < 0) || (d2 < 0 && d3 > 0)))
+    return 0;  // proper intersection
+  return std::min(std::min(distToSegment2(a0, a1, b0), distToSegment2(a0, a1, b1)),
+      std::min(distToSegment2(b0, b1, a0), distToSegment2(b0, b1, a1)));
+}
+
 // no reason not to have reasonable behavior for all structure nodes
-static bool isNearPoint(Point p, Dim radius, SvgNode* node)
+static bool isNearSegment(Point p0, Point p1, Dim radius, SvgNode* node)
 {
-  if(!node->bounds().pad(radius).contains(p))
+  Rect bbox = node->bounds();
+  if(!Rect(bbox).pad(radius).intersects(Rect::corners(p0, p1)))
     return false;
   if(node->asContainerNode()) {
     for(SvgNode* child : node->asContainerNode()->children())
-      if(isNearPoint(p, radius, child))
+      if(isNearSegment(p0, p1, radius, child))
         return true;
     return false;
   }
+  const Dim radius2 = radius*radius;
+  Point corners[] = {Point(bbox.left, bbox.top), Point(bbox.right, bbox.top),
+      Point(bbox.right, bbox.bottom), Point(bbox.left, bbox.bottom)};
   if(node->type() == SvgNode::IMAGE) {  //&& !Element::ERASE_IMAGES)
-    Rect bbox = node->bounds();
-    return std::abs(p.x - bbox.left) < radius || std::abs(p.x - bbox.right) < radius
-        || std::abs(p.y - bbox.top) < radius || std::abs(p.y - bbox.bottom) < radius;
+    for(int ii = 0; ii < 4; ++ii) {
+      if(segDist2(p0, p1, corners[ii], corners[(ii+1)%4]) < radius2)
+        return true;
+    }
+    return false;
   }
   if(node->type() != SvgNode::PATH)
     return true;  // bbox hit for non-path node
 
+  // subpaths are only closed for filled paths - open strokes (fill none) are not hit across their ends;
+  //  explicitly closed subpaths already end at start point
   const Path2D& path = *static_cast<SvgPath*>(node)->path();
   const Transform2D tf = node->totalTransform();
-  Dim dist = tf.isIdentity() ? path.distToPoint(p) : Path2D(path).transform(tf).distToPoint(p);
-  return dist < radius;
+  bool identity = tf.isIdentity();
+  bool filled = !node->getAttr("fill") || node->getColorAttr("fill", Color::NONE) != Color::NONE;
+  auto mapPt = [&](int ii) { return identity ? path.point(ii) : tf.map(path.point(ii)); };
+  Point start, prev;
+  for(int ii = 0; ii < path.size(); ++ii) {
+    Point pt = mapPt(ii);
+    int cmd = path.command(ii);
+    if(cmd == Path2D::MoveTo) {
+      if(filled && ii > 0 && segDist2(p0, p1, prev, start) < radius2)
+        return true;
+      start = pt;
+    }
+    else if((cmd == Path2D::CubicTo && ii + 2 < path.size()) || (cmd == Path2D::QuadTo && ii + 1 < path.size())) {
+      // flatten curve into segments no longer than about radius
+      bool cubic = cmd == Path2D::CubicTo;
+      Point c1 = pt, c2 = cubic ? mapPt(ii + 1) : pt, end = mapPt(cubic ? ii + 2 : ii + 1);
+      Dim len = (c1 - prev).dist() + (c2 - c1).dist() + (end - c2).dist();
+      int nsegs = std::min(32, std::max(1, int(std::ceil(len/std::max(radius, Dim(0.1))))));
+      Point a = prev;
+      for(int jj = 1; jj <= nsegs; ++jj) {
+        Dim t = Dim(jj)/nsegs, u = 1 - t;
+        Point b = cubic ? u*u*u*prev + 3*u*u*t*c1 + 3*u*t*t*c2 + t*t*t*end : u*u*prev + 2*u*t*c1 + t*t*end;
+        if(segDist2(p0, p1, a, b) < radius2)
+          return true;
+        a = b;
+      }
+      pt = end;
+      ii += cubic ? 2 : 1;
+    }
+    else if(segDist2(p0, p1, prev, pt) < radius2)
+      return true;
+    prev = pt;
+  }
+  return filled && path.size() > 0 && segDist2(p0, p1, prev, start) < radius2;
 }
 
 bool PathSelector::selectHit(Element* s)
 {
-  return isNearPoint(selPos, selRadius, s->node);
+  return isNearSegment(selPrev, selPos, selRadius, s->node);
 }
 
 void PathSelector::selectPath(Point p, Dim radius)
 {
   selRadius = radius;
   path.addPoint(p);
-  // subdivide as necessary to get sufficient point density
-  if(selPos.isNaN())
-    selPos = p;
-  Point dr = p - selPos;
-  Dim d = dr.dist();
-  int nsteps = int(d/(radius/2)) + 1;
-  Point step = dr/nsteps;
-  for(int ii = 0; ii < nsteps; ++ii) {
-    selPos += step;
-    selection->doSelect();
-  }
+  selPrev = selPos.isNaN() ? p : selPos;
+  selPos = p;
+  // only strokes near new segment are tested and strokes already selected are skipped (SELMODE_UNION)
+  selection->doSelect();
   bgDirty = true;
 }
 
@@ -948,6 +1013,12 @@ static bool overlapRuled(const RuledRange& range, Element* s)
   return false;
 }
 
+// selected strokes must overlap or have center of mass within selected lines
+Rect RuledSelector::hitBounds()
+{
+  return Rect::ltrb(MIN_DIM, selRange.ymin - selRange.yruling, MAX_DIM, selRange.ymax + selRange.yruling);
+}
+
 bool RuledSelector::selectHit(Element* s)
 {
   switch(selMode) {
@@ -1031,8 +1102,10 @@ void RuledSelector::findStops(Dim x, int linenum)
   if(nlines < 1) return;
   lstops.resize(nlines, margins.left);
   rstops.resize(nlines, margins.right);
-  // only want to scan stroke list once
-  for(Element* s : selection->sourceNode->children()) {
+  // only want to scan stroke list once; conservative mode only considers strokes passing through linenum
+  Dim y0 = colMode == COL_NORMAL ? page->getYforLine(linenum) - 0.5*yruling : MIN_DIM;
+  Dim y1 = colMode == COL_NORMAL ? page->getYforLine(linenum + 1) + 0.5*yruling : MAX_DIM;
+  for(Element* s : page->strokesInRect(Rect::ltrb(MIN_DIM, y0, MAX_DIM, y1))) {
     if(s->bbox().height() > MIN_DIV_HEIGHT*yruling) {
       // conservative mode requires that stroke passes through linenum
       if((colMode == COL_NORMAL)
@@ -1227,6 +1300,13 @@ bool LassoSelector::selectHit(Element* s)
   return isEnclosedBy(lasso, s->node);
 }
 
+// when adding a point, only the triangle swept by the new lasso segment (and the segment closing the lasso) can
+//  change, so only unselected strokes intersecting bbox of the triangle need to be tested
+Rect LassoSelector::hitBounds()
+{
+  return checkCollision ? Rect::ltrb(txmin, tymin, txmax, tymax) : lassoBBox;
+}
+
 Rect LassoSelector::getBGBBox()
 {
   return lassoBBox.isValid() ? selection->transform.mult(lassoBBox) : lassoBBox;
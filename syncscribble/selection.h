@@ -111,6 +111,9 @@ public:
   virtual ~Selector();
 
   virtual bool selectHit(Element* s) = 0;
+  // selectHit() must return false for any unselected element whose bbox does not intersect this; invalid rect
+  //  if unknown (selected elements are always retested)
+  virtual Rect hitBounds() { return Rect(); }
   virtual Rect getBGBBox() { return Rect(); }
   virtual void shrink() {}
   virtual void drawBG(Painter* painter) {}
@@ -137,6 +140,7 @@ public:
 
   void selectPath(Point p, Dim radius);
   bool selectHit(Element* s) override;
+  Rect hitBounds() override { return Rect::corners(selPrev, selPos).pad(selRadius); }
   Rect getBGBBox() override;
   void drawBG(Painter* painter) override;
 
@@ -144,6 +148,7 @@ private:
   Path2D path;
 
   Point selPos = Point(NaN, NaN);
+  Point selPrev = Point(NaN, NaN);  // selPrev to selPos is the current segment of the path
   Dim selRadius;
 };
 
@@ -157,6 +162,7 @@ public:
       : Selector(_sel), mZoom(zoom) { drawHandles = handles;  }
   void selectRect(Dim x0, Dim y0, Dim x1, Dim y1);
   bool selectHit(Element* s) override;
+  Rect hitBounds() override { return selRect; }
   void shrink() override;
   Rect getBGBBox() override;
   void drawBG(Painter* painter) override;
@@ -215,6 +221,7 @@ public:
   //void selectRuledBelow(int linenum);
   void findStops(Dim x, int linenum);
   bool selectHit(Element* s) override;
+  Rect hitBounds() override;
   void shrink() override;
   Rect getBGBBox() override;
   void drawBG(Painter* painter) override;
@@ -238,6 +245,7 @@ public:
   //void selectRect(Dim x0, Dim y0, Dim x1, Dim y1);
   void addPoint(Dim x, Dim y);
   bool selectHit(Element* s) override;
+  Rect hitBounds() override;
   //void shrink();
   Rect getBGBBox() override;
   void drawBG(Painter* painter) override;
@@ -75,6 +75,7 @@ void StrokeChangedItem::swapProps()
 {
   StrokeProperties temp = s->getProperties();
   s->setProperties(props);
+  page->onChangeStroke(s);
   props = temp;
 }
 
@@ -101,6 +102,7 @@ void StrokeTranslateItem::undo()
 {
   s->applyTransform(Transform2D::translating(-xoffset, -yoffset));
   s->commitTransform();
+  page->onChangeStroke(s);
   StrokeUndoItem::undo();
 }
 
@@ -108,6 +110,7 @@ void StrokeTranslateItem::redo()
 {
   s->applyTransform(Transform2D::translating(xoffset, yoffset));
   s->commitTransform();
+  page->onChangeStroke(s);
   StrokeUndoItem::redo();
 }
 
@@ -117,6 +120,7 @@ void StrokeTransformItem::undo()
 {
   s->applyTransform(transform.inverse());
   s->commitTransform();
+  page->onChangeStroke(s);
   StrokeUndoItem::undo();
 }
 
@@ -124,6 +128,7 @@ void StrokeTransformItem::redo()
 {
   s->applyTransform(transform);
   s->commitTransform();
+  page->onChangeStroke(s);
   StrokeUndoItem::redo();
 }
 
@@ -301,6 +306,16 @@ int UndoHistory::redo()
   return pagenum;
 }
 
+// stroke undo items hold pointers to page's Elements, so page cannot be unloaded if this returns true
+bool UndoHistory::refsPage(const Page* p) const
+{
+  for(UndoHistoryItem* item : hist) {
+    if(item->isA(UndoHistoryItem::STROKE_ITEM) && static_cast<StrokeUndoItem*>(item)->getPage() == p)
+      return true;
+  }
+  return false;
+}
+
 bool UndoHistory::canUndo() const
 {
   return !hist.empty() && pos > 0;
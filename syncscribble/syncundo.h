@@ -209,6 +209,7 @@ public:
   bool canRedo() const;
   bool undoable() const;
   size_t histPos() const { return pos; }
+  bool refsPage(const Page* p) const;
   static UUID_t newUuid();
 
   enum { MULTIPAGE = 0x40000000 };  // flag to OR with pagenum to indicate multiple pages are dirtied
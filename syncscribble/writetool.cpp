@@ -0,0 +1,210 @@
+// command line tool for batch conversion, PDF export, and document statistics - no SDL or GUI
+// usage: writetool <convert|export-pdf|stats> [options] <files...>
+//  -o <dir>: output folder (default is folder of input file)
+//  -f <svgz|svg|html>: output format for convert (default svgz)
+//  -c <level>: compression level for convert (default from document config)
+//  -j <n>: number of threads (default is number of cores)
+//  -no-thumb: don't save thumbnail when converting
+//  -fonts <dir>: folder containing Roboto-Regular.ttf and DroidSansFallback.ttf (default is folder of writetool)
+
+#include <chrono>
+#include <stdio.h>
+#include "ulib/painter.h"
+#include "usvg/svgnode.h"
+#include "document.h"
+#include "docconvert.h"
+#include "scribbleconfig.h"
+
+// implementations for single header libraries (as in application.cpp, minus GL and GUI)
+#define NANOVG_SW_IMPLEMENTATION
+#define NVGSW_QUIET_FRAME
+#include "nanovg_sw.h"
+
+#define FONTSTASH_IMPLEMENTATION
+#include "fontstash.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#define MINIZ_GZ_IMPLEMENTATION
+#include "ulib/miniz_gzip.h"
+
+#define PLATFORMUTIL_IMPLEMENTATION
+#include "ulib/platformutil.h"
+
+#define STRINGUTIL_IMPLEMENTATION
+#include "ulib/stringutil.h"
+
+#define FILEUTIL_IMPLEMENTATION
+#include "ulib/fileutil.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static double msecSince(Clock::time_point t0)
+{
+  return std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+}
+
+static int countNodes(SvgNode* node)
+{
+  int n = 1;
+  SvgContainerNode* container = node->asContainerNode();
+  if(container) {
+    for(SvgNode* child : container->children())
+      n += countNodes(child);
+  }
+  return n;
+}
+
+// per-page block sizes (for .svgz), compression ratio, stroke and node counts, and parse time
+static std::string docStats(const FSPath& fileinfo)
+{
+  auto t0 = Clock::now();
+  Document doc;
+  if(doc.load(new FileStream(fileinfo.c_str(), "rb"), true) == Document::LOAD_FATAL)
+    return fstring("%s: error loading document\n", fileinfo.c_str());
+  double loadms = msecSince(t0);
+  std::string res;
+  size_t ztotal = 0, total = 0;
+  int strokes = 0, nodes = 0;
+  for(int ii = 0; ii < doc.numPages(); ++ii) {
+    Page* page = doc.pages[ii];
+    std::string blockstr = "       -          -       -";
+    int idx = page->blockIdx;
+    if(idx >= 0 && idx + 1 < int(doc.blockInfo.size())) {
+      size_t zlen = doc.blockInfo[idx+1].offset - doc.blockInfo[idx].offset;
+      size_t len = uint32_t(doc.blockInfo[idx+1].len_cum - doc.blockInfo[idx].len_cum);
+      ztotal += zlen;
+      total += len;
+      blockstr = fstring("%8zu %10zu %7.2f", zlen, len, zlen > 0 ? double(len)/zlen : 0.0);
+    }
+    t0 = Clock::now();
+    bool ok = page->ensureLoaded(false) && page->loadStatus == Page::LOAD_OK;
+    double parsems = msecSince(t0);
+    int pagenodes = ok ? countNodes(page->svgDoc.get()) : 0;
+    strokes += page->strokeCount();
+    nodes += pagenodes;
+    res += fstring("  %4d %s %8d %8d %9.2f%s\n", ii + 1, blockstr.c_str(),
+        page->strokeCount(), pagenodes, parsems, ok ? "" : " (error)");
+    page->unload();  // bound memory use for large documents
+  }
+  std::string header = fstring("%s: %d pages, %lld bytes, %d strokes, %d nodes, index load %.2f ms",
+      fileinfo.c_str(), doc.numPages(), (long long)getFileSize(fileinfo), strokes, nodes, loadms);
+  if(ztotal > 0)
+    header += fstring(", compression %.2f", double(total)/ztotal);
+  return header + "\n  page    block   inflated   ratio  strokes    nodes  parse ms\n" + res;
+}
+
+// each file is processed independently, so just split files between threads; output is printed in order
+static void runStats(const std::vector<FSPath>& files, int nthreads)
+{
+  std::vector<std::string> results(files.size());
+  std::atomic_int next{0};
+  std::vector<std::thread> workers;
+  for(int ii = 0; ii < nthreads; ++ii) {
+    workers.emplace_back([&](){
+      for(int jj = next++; jj < int(files.size()); jj = next++)
+        results[jj] = docStats(files[jj]);
+    });
+  }
+  for(std::thread& t : workers)
+    t.join();
+  for(const std::string& s : results)
+    fputs(s.c_str(), stdout);
+}
+
+static int runConvert(const std::vector<FSPath>& files, const std::string& outdir, const std::string& ext,
+    int level, bool thumb, int nthreads)
+{
+  ScribbleConfig cfg;
+  DocConverter converter(&cfg);
+  converter.saveThumbnail = thumb && ext != "pdf";
+  converter.compressLevel = level;
+  converter.getDest = [&](const DocConverter::Job& job) {
+    FSPath dir = outdir.empty() ? job.src.parent() : FSPath(outdir);
+    FSPath dest = dir.child(job.src.baseName() + "." + ext);
+    if(dest.path == job.src.path) {
+      fprintf(stderr, "%s: output would overwrite input - use -o or -f\n", job.src.c_str());
+      return FSPath();
+    }
+    return dest;
+  };
+  converter.start(files, nthreads);
+  // bounds of loaded documents are calculated here, on main thread
+  while(converter.update())
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+  int nerrors = 0;
+  for(const DocConverter::Job& job : converter.results()) {
+    if(job.status == DocConverter::CONVERTED)
+      printf("%s -> %s%s\n", job.src.c_str(), job.dest.c_str(), job.loadErrors ? " (with load errors)" : "");
+    else if(job.status != DocConverter::SKIPPED) {
+      fprintf(stderr, "%s: error %s\n", job.src.c_str(), job.status == DocConverter::LOAD_ERROR ? "loading" : "saving");
+      ++nerrors;
+    }
+  }
+  return nerrors > 0 ? 1 : 0;
+}
+
+int main(int argc, char* argv[])
+{
+  if(argc < 3) {
+    fprintf(stderr, "usage: %s <convert|export-pdf|stats> [-o outdir] [-f svgz|svg|html] [-c level] [-j threads]"
+        " [-no-thumb] [-fonts dir] <files...>\n", argv[0]);
+    return 2;
+  }
+  std::string cmd = argv[1];
+  std::string outdir, ext = "svgz", fontdir = FSPath(argv[0]).parentPath();
+  int level = -1, nthreads = 0;
+  bool thumb = true;
+  std::vector<FSPath> files;
+  for(int ii = 2; ii < argc; ++ii) {
+    std::string arg = argv[ii];
+    if(arg == "-o" && ii + 1 < argc)
+      outdir = argv[++ii];
+    else if(arg == "-f" && ii + 1 < argc)
+      ext = argv[++ii];
+    else if(arg == "-c" && ii + 1 < argc)
+      level = atoi(argv[++ii]);
+    else if(arg == "-j" && ii + 1 < argc)
+      nthreads = atoi(argv[++ii]);
+    else if(arg == "-no-thumb")
+      thumb = false;
+    else if(arg == "-fonts" && ii + 1 < argc)
+      fontdir = argv[++ii];
+    else
+      files.emplace_back(argv[ii]);
+  }
+  if(files.empty() || !containsWord("svgz svg html", ext.c_str())) {
+    fprintf(stderr, "%s: no input files or invalid output format\n", argv[0]);
+    return 2;
+  }
+  if(!outdir.empty())
+    createPath(outdir.c_str());
+
+  // same fonts as app on Linux (see setupResources()); text is measured when calculating bounds and w/o fonts
+  //  would be missing from PDF, so export fails if fonts can't be loaded
+  Painter::initFontStash(FONS_DELAY_LOAD | FONS_SUMMED);
+  bool hasfonts = Painter::loadFont("ui-sans", FSPath(fontdir, "Roboto-Regular.ttf").c_str());
+  if(hasfonts && Painter::loadFont("fallback", FSPath(fontdir, "DroidSansFallback.ttf").c_str()))
+    Painter::addFallbackFont(NULL, "fallback");
+  if(!hasfonts) {
+    fprintf(stderr, "%s: unable to load fonts from %s - use -fonts <dir>\n", argv[0], fontdir.c_str());
+    if(cmd == "export-pdf")
+      return 1;
+  }
+  Document::workerPool();
+  if(nthreads <= 0)
+    nthreads = std::max(1, Document::numWorkers);
+
+  if(cmd == "convert")
+    return runConvert(files, outdir, ext, level, thumb, nthreads);
+  if(cmd == "export-pdf")
+    return runConvert(files, outdir, "pdf", -1, false, nthreads);
+  if(cmd == "stats") {
+    runStats(files, nthreads);
+    return 0;
+  }
+  fprintf(stderr, "%s: unknown command %s\n", argv[0], cmd.c_str());
+  return 2;
+}